@@ -7,7 +7,23 @@ static App *app;
 #include "video_fetcher.cpp"
 #include "video_lister.cpp"
 #include "renderer.cpp"
+#include "scopes.cpp"
+#include "project.cpp"
+#include "text.cpp"
+#include "captions.cpp"
+#include "frame_cache.cpp"
+#include "frame_pool.cpp"
+#include "keyframe_index.cpp"
 #include "video.cpp"
+#include "video_decoder.cpp"
+#include "decoder_pool.cpp"
+#include "thumbnails.cpp"
+#include "timeline.cpp"
+#include "audio_output.cpp"
+#include "audio.cpp"
+#include "encoder.cpp"
+#include "export.cpp"
+#include "proxy.cpp"
 #include "sequencer.cpp"
 
 static void app_init() {
@@ -19,16 +35,21 @@ static void app_init() {
 
   video_fetcher_init(&app->vid_fetcher);
   video_lister_init(&app->vid_lister);
-  renderer_init(&app->renderer);
+  project_init(&app->project);
 
-  app->video_arena = arena_alloc((Arena_Params){
-    .reserve_size = MiB(64),
-    .commit_size = MiB(64),
-  });
+  u32 preview_width, preview_height;
+  project_preview_size(&app->project, false, &preview_width, &preview_height);
+  renderer_init(&app->renderer, preview_width, preview_height);
+  scopes_init(&app->scopes, &app->renderer.target);
 
-  video_open(&app->video, "./videos/jackal.mp4");
+  captions_init(&app->captions, CAPTION_DEFAULT_FONT);
+  captions_load(&app->captions, "./videos/jackal.captions.txt");
 
-  app->video_texture = create_yuv_texture(video_width(&app->video), video_height(&app->video));
+  decoder_pool_init(&app->decoder_pool, DECODER_POOL_DEFAULT_MAX_OPEN, DECODER_POOL_DEFAULT_BUDGET);
+  proxy_generator_init(&app->proxies);
+  audio_init(&app->audio, "./videos/jackal.mp4", audio_sink_from_env());
+
+  frame_cache_init(&app->frame_cache, FRAME_CACHE_DEFAULT_BUDGET);
 
   app->sequencer.theme = (Sequencer_Theme){
     .text = ImColor(232, 236, 244),
@@ -42,10 +63,27 @@ static void app_init() {
   app->sequencer.pan = -0.2f;
 
   app->sequencer.timeline_height = 80.0f;
+  app->sequencer.track_height = 40.0f;
   app->sequencer.lister_width = 160.0f;
   app->sequencer.border_width = 1.0f;
 
-  app->sequencer.max_time = video_duration(&app->video);
+  Timeline *tl = &app->timeline;
+  timeline_init(tl);
+  u32 track = timeline_add_track(tl, "V1");
+
+  // only probes the source, its clips are decoded by the decoder pool
+  Video probe = {0};
+  if (video_open(&probe, "./videos/jackal.mp4", VIDEO_OPEN_FLAG__KEYFRAMES_ONLY)) {
+    u32 source = timeline_add_source(tl, "./videos/jackal.mp4", video_duration(&probe));
+    timeline_add_clip(tl, source, track, 0.0, 0.0, tl->sources[source].duration);
+    thumbnail_strip_init(&app->thumbnails, &probe, "./videos/jackal.mp4");
+    video_close(&probe);
+  }
+
+  app->sequencer.max_time = timeline_duration(tl);
+
+  proxy_refresh_timeline(tl);
+  app->use_proxies = true;
 
   ProfileEnd();
 }
@@ -53,10 +91,103 @@ static void app_init() {
 static void app_shutdown() {
   ProfileFuncBegin();
 
-  video_close(&app->video);
+  timeline_shutdown(&app->timeline);
+  audio_shutdown(&app->audio);
+  thumbnail_strip_shutdown(&app->thumbnails);
+  proxy_generator_shutdown(&app->proxies);
+  decoder_pool_shutdown(&app->decoder_pool);
+  frame_cache_shutdown(&app->frame_cache);
+  frame_pools_shutdown();
+  captions_shutdown(&app->captions);
+  scopes_shutdown(&app->scopes);
   renderer_shutdown(&app->renderer);
   video_fetcher_shutdown(&app->vid_fetcher);
   video_lister_shutdown(&app->vid_lister);
+  scratch_release_thread();
+
+  ProfileEnd();
+}
+
+// Exports the timeline as edited, every layer with its transform and effects,
+// at the project resolution. The UI waits until the file is written.
+static void export_window() {
+  ProfileFuncBegin();
+
+  if (ImGui::Begin("Project")) {
+    ImGui::SeparatorText("export");
+
+    static char path[MAX_PATH_LENGTH] = "./export.mp4";
+    static s32 last_result = -1;
+    ImGui::InputText("output", path, sizeof(path));
+    if (ImGui::Button("Export")) {
+      app->sequencer.state = PLAYBACK_STATE__PAUSE;
+
+      Export_Params params = {0};
+      snprintf(params.output_path, MAX_PATH_LENGTH, "%s", path);
+      params.width = app->project.width;
+      params.height = app->project.height;
+
+      // renders through the preview's renderer for its LUTs, then puts the preview size back
+      Renderer *r = &app->renderer;
+      u32 preview_width = r->target.width;
+      u32 preview_height = r->target.height;
+      last_result = export_timeline(r, &app->timeline, &app->captions, &params);
+      renderer_resize(r, preview_width, preview_height);
+    }
+    if (last_result >= 0) {
+      ImGui::SameLine();
+      ImGui::Text(last_result == 0 ? "exported" : "export failed");
+    }
+  }
+  ImGui::End();
+
+  ProfileEnd();
+}
+
+// Transforms and effects of the clips at the playhead, edited on the timeline's clips.
+static void layers_window() {
+  ProfileFuncBegin();
+
+  if (ImGui::Begin("Layers")) {
+    Timeline *tl = &app->timeline;
+
+    for (s32 i = (s32)app->num_layers - 1; i >= 0; --i) {
+      Timeline_Clip *clip = timeline_find_clip(tl, app->layers[i].clip.id);
+      if (clip == NULL) continue;
+
+      ImGui::PushID((s32)clip->id);
+      if (ImGui::CollapsingHeader(tl->tracks[clip->track].name, ImGuiTreeNodeFlags_DefaultOpen)) {
+        Layer_Transform *transform = &clip->transform;
+        ImGui::DragFloat2("position", &transform->x, 0.005f, -1.0f, 1.0f);
+        ImGui::DragFloat("scale", &transform->scale, 0.005f, 0.01f, 10.0f);
+        ImGui::DragFloat("rotation", &transform->rotation, 0.5f, -180.0f, 180.0f);
+        ImGui::DragFloat4("crop", transform->crop, 0.005f, 0.0f, 0.5f);
+        ImGui::SliderFloat("opacity", &transform->opacity, 0.0f, 1.0f);
+        if (ImGui::Button("Reset")) {
+          *transform = layer_transform_identity;
+        }
+
+        ImGui::SeparatorText("effects");
+        effect_chain_editor(&app->renderer, &clip->effects);
+      }
+      ImGui::PopID();
+    }
+
+    // a copy of the top clip in the corner, on a new track above everything
+    Timeline_Clip *top = app->num_layers > 0 ? timeline_find_clip(tl, app->layers[app->num_layers - 1].clip.id) : NULL;
+    if (top && tl->num_tracks < TIMELINE_MAX_TRACKS && ImGui::Button("Add picture-in-picture")) {
+      char name[32];
+      snprintf(name, sizeof(name), "V%u", tl->num_tracks + 1);
+      u32 track = timeline_add_track(tl, name);
+      Timeline_Clip copy = *top;
+      u32 index = timeline_add_clip(tl, copy.source, track, copy.start, copy.in_point, copy.out_point);
+      Layer_Transform *transform = &tl->clips[index].transform;
+      transform->scale = 0.35f;
+      transform->x = 0.25f;
+      transform->y = -0.3f;
+    }
+  }
+  ImGui::End();
 
   ProfileEnd();
 }
@@ -68,37 +199,76 @@ static void app_update_ui() {
 
   video_fetcher_window(&app->vid_fetcher);
   video_lister_window(&app->vid_lister);
+  project_window(&app->project, &app->renderer.target);
+  export_window();
+  proxy_generator_window(&app->proxies, &app->vid_lister, &app->use_proxies);
 
   renderer_draw_debug_ui(&app->renderer);
+  frame_cache_debug_ui(&app->frame_cache);
+  audio_debug_ui(&app->audio);
+  scopes_window(&app->scopes);
+  decoder_pool_debug_ui(&app->decoder_pool);
+  arena_memory_window();
+  frame_pools_debug_ui();
 
   if (ImGui::Begin("Video Player")) {
-    Video *video = &app->video;
+    Timeline *tl = &app->timeline;
 
     static f32 t = 0.0f;
-    ImGui::SliderFloat("Timestamp", &t, 0.0f,
-                      video->fmt_ctx->duration / AV_TIME_BASE);
+    ImGui::SliderFloat("Timestamp", &t, 0.0f, app->sequencer.max_time);
+
+    // the cost is only known when the clip at t already has an open decoder
+    Timeline_Clip *clip = timeline_clip_at(tl, t);
+    Decoder_Pool_Entry *seek_entry = clip ? decoder_pool_find(&app->decoder_pool, clip->id) : NULL;
+    if (decoder_pool_entry_is_ready(seek_entry)) {
+      ImGui::SameLine();
+      f64 source_sec = clip->in_point + (t - clip->start);
+      ImGui::Text("(%lld frames to decode)", video_seek_cost(&seek_entry->video, source_sec));
+    }
     if (ImGui::Button("Seek")) {
-      video_seek(video, t);
-    }
-    f64 sec = pts_to_sec(video->time_base, video->frame->pts);
-    s32 min = (s32)(sec / 60.0);
-    sec -= min * 60.0;
-    s32 hours = min / 60;
-    min -= hours * 60;
-    ImGui::Text("%dh %dm %.2fs", hours, min, sec);
-
-    f32 aspect = (f32)app->video_texture.width / (f32)app->video_texture.height;
-    f32 height = 60.0f;
-    ImGui::Image(app->video_texture.ids[0], ImVec2(height * aspect, height));
-    ImGui::SameLine();
-    ImGui::Image(app->video_texture.ids[1], ImVec2(height * aspect, height));
-    ImGui::Image(app->video_texture.ids[2], ImVec2(height * aspect, height));
+      app->sequencer.playback_time = t;
+    }
+
+    Decoder_Pool_Entry *entry = app->active_entry;
+    Frame_Cache_Entry *display = app->num_layers > 0 ? app->layers[app->num_layers - 1].frame : NULL;
+    if (decoder_pool_entry_is_ready(entry)) {
+      Video *video = &entry->video;
+      f64 sec = display ? video_pts_to_sec(video, display->pts) : 0.0;
+      s32 min = (s32)(sec / 60.0);
+      sec -= min * 60.0;
+      s32 hours = min / 60;
+      min -= hours * 60;
+      ImGui::Text("%dh %dm %.2fs", hours, min, sec);
+      ImGui::Text("%.3f fps", video_fps(video));
+      video_decoder_stats_ui(&entry->decoder);
+    } else {
+      ImGui::Text("no decoder at the playhead");
+    }
+
+    Playback_Stats *stats = &app->playback_stats;
+    ImGui::Text("cuts: %llu, hitches: %llu, prerolled frames: %llu",
+                stats->cuts, stats->cut_hitches, stats->prerolled);
+
+    if (display) {
+      YUV_Texture *texture = &display->texture;
+      f32 aspect = (f32)texture->width / (f32)texture->height;
+      f32 height = 60.0f;
+      ImGui::Image(texture->ids[0], ImVec2(height * aspect, height));
+      ImGui::SameLine();
+      ImGui::Image(texture->ids[1], ImVec2(height * aspect, height));
+      if (texture->ids[2]) {
+        ImGui::Image(texture->ids[2], ImVec2(height * aspect, height));
+      }
+    }
   }
   ImGui::End();
 
+  layers_window();
+  captions_window(&app->captions, app->sequencer.playback_time);
+
   ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
   if (ImGui::Begin("Preview")) {
-    f32 aspect = (f32)app->renderer.target.width / (f32)app->renderer.target.height;
+    f32 aspect = (f32)app->project.width / (f32)app->project.height;
     ImVec2 size = ImGui::GetContentRegionAvail();
     ImVec2 image_size = ImVec2(size.x, size.x / aspect);
     if (image_size.y > size.y) {
@@ -110,19 +280,254 @@ static void app_update_ui() {
   ImGui::End();
   ImGui::PopStyleVar(1);
 
-  draw_sequencer(&app->sequencer);
+  draw_sequencer(&app->sequencer, &app->timeline, &app->thumbnails);
+
+  ProfileEnd();
+}
+
+// The file the preview decodes for the clip. Proxies keep the source's
+// timestamps, so the same source seconds work for either.
+static const char *clip_source_path(Timeline *tl, Timeline_Clip *clip) {
+  Timeline_Source *source = &tl->sources[clip->source];
+  return app->use_proxies && source->has_proxy ? source->proxy_path : source->path;
+}
+
+// Gets the clip after the next cut ready ahead of time: its decoder is opened
+// (or an idle one seeked) to the cut, and once the first frame is decoded it
+// is uploaded into the frame cache, so the cut is a cache hit at the exact pts.
+static void preroll_next_clip(f64 time, Timeline_Clip *current) {
+  ProfileFuncBegin();
+
+  Timeline *tl = &app->timeline;
+
+  // the next cut is the earliest clip start or end after the playhead
+  u32 *clips;
+  u32 count = timeline_query(tl, time, time + DECODER_POOL_PREWARM_TIME, &clips);
+  f64 cut = INFINITY;
+  for (u32 i = 0; i < count; ++i) {
+    Timeline_Clip *clip = &tl->clips[clips[i]];
+    if (clip->start > time) cut = Min(cut, clip->start);
+    f64 end = timeline_clip_end(clip);
+    if (end > time && end < time + DECODER_POOL_PREWARM_TIME) cut = Min(cut, end);
+  }
+
+  Timeline_Clip *next = cut != INFINITY ? timeline_clip_at(tl, cut) : NULL;
+  if (next && (current == NULL || next->id != current->id)) {
+    f64 sec = next->in_point + (cut - next->start);
+    Decoder_Pool_Entry *entry = decoder_pool_request(&app->decoder_pool, next->id,
+                                                     clip_source_path(tl, next), sec);
+
+    if (decoder_pool_entry_is_ready(entry)) {
+      Video *video = &entry->video;
+      s64 pts = video_sec_to_pts(video, sec);
+
+      if (entry->preroll_sec != sec) {
+        // the decoder was used before and is somewhere else
+        video_decoder_seek(&entry->decoder, sec);
+        entry->preroll_sec = sec;
+      }
+
+      Video_Frame_YUV frame;
+      if (!frame_cache_contains(&app->frame_cache, video->source_id, pts) &&
+          video_decoder_peek_frame(&entry->decoder, &frame) &&
+          frame.pts <= pts && pts < frame.pts + frame.duration) {
+        Frame_Cache_Entry *cached = frame_cache_insert(&app->frame_cache, video->source_id, &frame);
+        upload_frame_to_texture(&app->renderer, &cached->texture, frame);
+        app->playback_stats.prerolled++;
+      }
+    }
+  }
+
+  ProfileEnd();
+}
+
+// Picks the clip's frame at time, from the frame cache if possible and from
+// its decoder otherwise. Keeps previous up while the decoder is still opening.
+// The layer's frame, NULL if its cache entry was evicted or now holds another frame.
+static Frame_Cache_Entry *preview_layer_frame(Preview_Layer *layer) {
+  Frame_Cache_Entry *frame = layer->frame;
+  bool is_valid = frame && frame->is_used && frame->source_id == layer->source_id && frame->pts == layer->pts;
+  return is_valid ? frame : NULL;
+}
+
+static Frame_Cache_Entry *present_clip_frame(Timeline_Clip *clip, f64 time, Frame_Cache_Entry *previous,
+                                             Decoder_Pool_Entry **out_entry, bool *out_is_current) {
+  ProfileFuncBegin();
+
+  Decoder_Pool *pool = &app->decoder_pool;
+  Timeline *tl = &app->timeline;
+
+  // checked by preview_layer_frame, NULL if evicted or recycled since the last frame
+  Frame_Cache_Entry *result = previous;
+
+  f64 sec = clip->in_point + (time - clip->start);
+  Decoder_Pool_Entry *entry = decoder_pool_request(pool, clip->id, clip_source_path(tl, clip), sec);
+  *out_entry = entry;
+  *out_is_current = false;
+
+  if (decoder_pool_entry_is_ready(entry)) {
+    // presenting moves the decoder away from any preroll position
+    entry->preroll_sec = NAN;
+
+    Video *video = &entry->video;
+    s64 pts = video_sec_to_pts(video, sec);
+
+    if (result == NULL || !frame_cache_entry_covers(result, video->source_id, pts)) {
+      Frame_Cache_Entry *cached = frame_cache_lookup(&app->frame_cache, video->source_id, pts);
+      if (cached) {
+        result = cached;
+      } else {
+        Video_Frame_YUV frame;
+        if (video_decoder_acquire_frame(&entry->decoder, sec, &frame)) {
+          result = frame_cache_insert(&app->frame_cache, video->source_id, &frame);
+          upload_frame_to_texture(&app->renderer, &result->texture, frame);
+          video_decoder_release_frame(&entry->decoder);
+        }
+      }
+    }
+
+    *out_is_current = result && frame_cache_entry_covers(result, video->source_id, pts);
+  } else {
+    pool->not_ready++;
+  }
+
+  ProfileEnd();
+
+  return result;
+}
+
+// Picks the frame of every visible clip at the playhead, one layer per clip
+// from the lowest track to the highest.
+static void update_video_frame() {
+  ProfileFuncBegin();
+
+  Timeline *tl = &app->timeline;
+  f64 time = app->sequencer.playback_time;
+
+  // clips cover [start, end), playback stops at the end of the last one and
+  // should keep showing its last frame
+  f64 duration = timeline_duration(tl);
+  if (duration > 0.0 && time >= duration) {
+    time = duration - 1e-6;
+  }
+
+  decoder_pool_begin_frame(&app->decoder_pool);
+
+  // copied, the preroll's queries overwrite the results
+  Timeline_Clip clips[RENDERER_MAX_LAYERS];
+  u32 num_clips = 0;
+  u32 *results;
+  u32 count = timeline_query(tl, time, time + 1e-9, &results);
+  for (u32 i = 0; i < count && num_clips < RENDERER_MAX_LAYERS; ++i) {
+    Timeline_Clip *clip = &tl->clips[results[i]];
+    if (tl->tracks[clip->track].is_hidden) continue;
+
+    u32 j = num_clips++;
+    for (; j > 0 && clips[j - 1].track > clip->track; --j) {
+      clips[j] = clips[j - 1];
+    }
+    clips[j] = *clip;
+  }
+
+  // the decoders on screen stay open while the preroll and the other clips request theirs
+  for (u32 i = 0; i < num_clips; ++i) {
+    decoder_pool_touch(&app->decoder_pool, clips[i].id);
+  }
+
+  Timeline_Clip *top = num_clips > 0 ? &clips[num_clips - 1] : NULL;
+  preroll_next_clip(time, top);
+
+  bool is_cut = top && top->id != app->active_clip_id && app->sequencer.state == PLAYBACK_STATE__PLAY;
+  app->active_clip_id = top ? top->id : UINT32_MAX;
+  app->active_entry = NULL;
+
+  Preview_Layer layers[RENDERER_MAX_LAYERS];
+  for (u32 i = 0; i < num_clips; ++i) {
+    Timeline_Clip *clip = &clips[i];
+
+    // the clip's last frame, or across a cut the last frame of the clip before it on the same track
+    Frame_Cache_Entry *previous = NULL;
+    for (u32 j = 0; j < app->num_layers; ++j) {
+      Preview_Layer *layer = &app->layers[j];
+      if (layer->clip.id == clip->id) {
+        previous = preview_layer_frame(layer);
+        break;
+      }
+      if (layer->clip.track == clip->track) {
+        previous = preview_layer_frame(layer);
+      }
+    }
+
+    Decoder_Pool_Entry *entry;
+    bool is_current;
+    layers[i].clip = *clip;
+    layers[i].frame = present_clip_frame(clip, time, previous, &entry, &is_current);
+    if (layers[i].frame) {
+      layers[i].source_id = layers[i].frame->source_id;
+      layers[i].pts = layers[i].frame->pts;
+    }
+
+    if (clip == top) {
+      app->active_entry = entry;
+      if (is_cut) {
+        app->playback_stats.cuts++;
+        if (!is_current) app->playback_stats.cut_hitches++;
+      }
+    }
+  }
+
+  memcpy(app->layers, layers, num_clips * sizeof(Preview_Layer));
+  app->num_layers = num_clips;
+
+  ProfileEnd();
+}
+
+// The audio clock is the master clock when there is audio. Any other change
+// to playback_time (scrubbing, stop, seek) since the last sync moves the audio.
+static void update_playback_clock(f64 delta_time) {
+  ProfileFuncBegin();
+
+  Sequencer *seq = &app->sequencer;
+  Audio *audio = &app->audio;
+
+  if (audio->has_stream) {
+    if (fabs(seq->playback_time - app->audio_synced_time) > AUDIO_SEEK_THRESHOLD) {
+      audio_seek(audio, seq->playback_time);
+    }
+    audio_set_playing(audio, seq->state == PLAYBACK_STATE__PLAY);
+    update_sequencer_from_clock(seq, audio_clock(audio));
+  } else {
+    update_sequencer(seq, delta_time);
+  }
+
+  app->audio_synced_time = seq->playback_time;
 
   ProfileEnd();
 }
 
 static void app_update(f64 delta_time) {
   ProfileFuncBegin();
+
+  arena_profile_counters();
   
-  update_sequencer(&app->sequencer, delta_time);
+  update_playback_clock(delta_time);
 
-  arena_pop_to(app->video_arena, 0);
-  Video_Frame_YUV frame = video_read_frame(&app->video, app->video_arena);
-  upload_frame_to_texture(app->video_texture, frame);
+  if (app->proxies.num_done != app->proxies_seen_done) {
+    app->proxies_seen_done = app->proxies.num_done;
+    proxy_refresh_timeline(&app->timeline);
+  }
+
+  // a smaller preview while playing, full resolution once paused
+  u32 preview_width, preview_height;
+  bool is_playing = app->sequencer.state == PLAYBACK_STATE__PLAY;
+  project_preview_size(&app->project, is_playing, &preview_width, &preview_height);
+  renderer_resize(&app->renderer, preview_width, preview_height);
+  scopes_resize(&app->scopes, &app->renderer.target);
+  app->renderer.fit_mode = app->project.fit_mode;
+
+  update_video_frame();
+  thumbnail_strip_update(&app->thumbnails);
+  scopes_update(&app->scopes);
 
   app_update_ui();
 
@@ -132,7 +537,19 @@ static void app_update(f64 delta_time) {
 static void app_draw() {
   ProfileFuncBegin();
 
-  renderer_draw(&app->renderer, app->video_texture);
+  Renderer *r = &app->renderer;
+  renderer_begin_layers(r);
+  for (u32 i = 0; i < app->num_layers; ++i) {
+    Preview_Layer *layer = &app->layers[i];
+    Frame_Cache_Entry *frame = preview_layer_frame(layer);
+    if (frame) {
+      renderer_push_layer(r, frame->texture, &layer->clip.transform, &layer->clip.effects, layer->clip.track);
+    }
+  }
+  // clears the target when nothing is visible
+  renderer_draw_layers(r);
+  captions_draw(&app->captions, &r->target, app->sequencer.playback_time);
+  scopes_capture(&app->scopes, &app->renderer.target);
 
   ProfileEnd();
 }
\ No newline at end of file
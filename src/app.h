@@ -6,9 +6,16 @@ extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
+#include <libswresample/swresample.h>
+#include <libavutil/opt.h>
 }
 
 #include <pthread.h>
+#include <atomic>
+
+// imgui's copy, the implementation is compiled into text.cpp
+#define STBTT_STATIC
+#include "imstb_truetype.h"
 
 #define MAX_URL_LENGTH 256
 #define MAX_PATH_LENGTH 256
@@ -17,7 +24,66 @@ extern "C" {
 #define ARENA_DEFAULT_COMMIT_SIZE MiB(64)
 #define ARENA_DEFAULT_FLAGS ARENA_FLAG__NONE
 
-#define ARENA_HEADER_SIZE 64
+#define ARENA_HEADER_SIZE 128
+#define ARENA_FREELIST_MAX_BYTES MiB(512) // blocks of released arenas kept mapped for new ones
+#define ARENA_DEFAULT_DECOMMIT_THRESHOLD MiB(16) // resident bytes a block keeps after a pop, at least
+#define ARENA_REGISTRY_SIZE 512 // arenas tracked for the memory window
+
+#define SCRATCH_ARENA_COUNT 2 // per thread, enough for one level of conflicts
+#define SCRATCH_ARENA_RESERVE_SIZE MiB(64)
+#define SCRATCH_ARENA_COMMIT_SIZE KiB(64)
+
+#define VIDEO_DECODER_RING_SIZE 8
+#define UPLOAD_RING_SIZE 3
+#define RENDERER_MAX_LAYERS 32 // layers composited into one output frame
+#define EFFECT_CHAIN_MAX 8 // effects on one clip
+#define EFFECT_MAX_LUTS 16
+#define RENDER_TARGET_POOL_SIZE 16 // intermediate targets shared by all effect chains
+#define READBACK_RING_SIZE 3 // frames in flight between render and readback
+
+#define EXPORT_MAX_INPUTS 64
+
+#define THUMBNAIL_MAX_SIZE 96 // longest side of a thumbnail in pixels
+#define THUMBNAIL_ATLAS_SIZE 2048
+#define THUMBNAIL_MIN_INTERVAL 1.0 // seconds
+#define THUMBNAIL_UPLOADS_PER_FRAME 16
+
+#define AUDIO_OUTPUT_SAMPLE_RATE 48000
+#define AUDIO_OUTPUT_CHANNELS 2
+#define AUDIO_RING_FRAMES (1 << 15) // ~680ms at 48kHz, must be a power of two
+#define AUDIO_MAX_CHUNK_FRAMES 8192 // largest block the decoder writes at once
+#define AUDIO_SINK_PERIOD_MS 10
+#define AUDIO_SEEK_THRESHOLD 0.05 // seconds
+
+#define DECODER_POOL_MAX_ENTRIES 16
+#define DECODER_POOL_DEFAULT_MAX_OPEN 6 // open files and decoder threads
+#define DECODER_POOL_DEFAULT_BUDGET MiB(256) // decoded frames held by all decoders
+#define DECODER_POOL_PREWARM_TIME 2.0 // seconds before a cut the next clip's decoder is opened
+
+#define PROXY_MAX_HEIGHT 540
+#define PROXY_MAX_JOBS 1024
+
+#define PROJECT_DEFAULT_WIDTH 1080
+#define PROJECT_DEFAULT_HEIGHT 1920
+#define PROJECT_DEFAULT_PLAYBACK_SCALE 0.5f // preview resolution while playing
+
+#define GLYPH_ATLAS_SIZE 1024
+#define GLYPH_PIXEL_HEIGHT 64.0f // glyphs are rasterized as distance fields at this size and scaled when drawn
+#define GLYPH_SDF_PADDING 8 // pixels of distance field around each glyph
+#define GLYPH_CACHE_SIZE 1024 // must be a power of two
+#define TEXT_MAX_GLYPHS 4096 // quads in one text batch
+
+#define CAPTION_MAX_BLOCKS 1024
+#define CAPTION_MAX_WORDS 16384
+#define CAPTION_TEXT_SIZE KiB(256)
+#define CAPTION_DEFAULT_FONT "./assets/CommitMono.ttf"
+
+#define FRAME_CACHE_MAX_ENTRIES 256
+#define FRAME_CACHE_DEFAULT_BUDGET MiB(512)
+#define FRAME_POOL_MAX_POOLS 16 // resolution and layout combinations
+#define FRAME_POOL_MAX_BUFFERS 64 // per pool, frames beyond that go to the caller's arena
+#define FRAME_POOL_ALIGNMENT 64 // of planes and strides, a cache line and the widest SIMD load
+#define VIDEO_DECODER_SEEK_THRESHOLD 1.0 // seconds ahead of the decoder before we seek instead of decoding
 
 enum Arena_Flags {
   ARENA_FLAG__NONE = 0,
@@ -26,10 +92,46 @@ enum Arena_Flags {
 };
 
 struct Arena_Params {
+  const char *name; // groups the arena in the memory window, a string literal
   Arena_Flags flags;
   u64 reserve_size;
   u64 commit_size;
   void *optional_backing_buffer;
+  u64 decommit_threshold; // 0 means ARENA_DEFAULT_DECOMMIT_THRESHOLD
+};
+
+// Sizes of one arena over all of its blocks, including those on its own
+// freelist. Only the thread using the arena writes them, the memory window
+// reads them while it runs.
+struct Arena_Info {
+  const char *name;
+  bool is_used;
+
+  std::atomic<u64> reserved;
+  std::atomic<u64> committed;
+  std::atomic<u64> resident; // upper bound, what was touched and not decommitted since
+  std::atomic<u64> used;     // arena_pos
+  std::atomic<u64> peak_committed;
+  std::atomic<u64> peak_resident;
+  std::atomic<u64> peak_used;
+  std::atomic<u32> num_blocks; // chain length
+  std::atomic<u64> pushes;
+};
+
+// Arenas with the same name, summed for the memory window.
+struct Arena_Group {
+  const char *name;
+  u32 count;
+  u32 num_blocks;
+  u64 reserved, committed, resident, used;
+  u64 peak_committed, peak_resident, peak_used;
+  u64 pushes;
+};
+
+struct Arena_Registry {
+  pthread_mutex_t mutex;
+  Arena_Info infos[ARENA_REGISTRY_SIZE];
+  u32 untracked; // arenas created while the table was full
 };
 
 struct Arena {
@@ -44,23 +146,195 @@ struct Arena {
   u64 cmt;
   u64 res;
 
-  // freelist?
+  // blocks popped off this arena, reused before new ones are mapped
+  Arena *free_last;
+  u64 free_size;
+
+  u64 high_water; // pages below it may be resident, nothing above was touched since the last decommit
+  u64 decommit_threshold;
+
+  Arena_Info *info; // shared by all blocks of the arena, NULL when untracked
+};
+
+// A position to pop back to, see temp_begin and scratch_begin.
+struct Temp {
+  Arena *arena;
+  u64 pos;
+};
+
+// Blocks of released arenas, handed to new arenas with the same reserve size
+// instead of unmapping and mapping them again. Shared by all threads.
+struct Arena_Freelist {
+  pthread_mutex_t mutex;
+  Arena *last;
+  u64 size;
+};
+
+// Counters over all arenas, bumped from any thread.
+struct Arena_Stats {
+  std::atomic<u64> fresh_maps;
+  std::atomic<u64> huge_maps; // fresh maps backed by MAP_HUGETLB pages
+  std::atomic<u64> reuses;    // blocks that came from a freelist instead of mmap
+  std::atomic<u64> unmaps;
+  std::atomic<u64> decommitted; // bytes given back with MADV_DONTNEED
+};
+
+// How a frame's planes are laid out, each is uploaded as is and converted to
+// RGB in the fragment shader.
+enum Pixel_Layout {
+  PIXEL_LAYOUT__YUV420P,   // Y, U, V planes of 8 bit samples
+  PIXEL_LAYOUT__YUV420P10, // Y, U, V planes of 16 bit samples, 10 bits used from the bottom
+  PIXEL_LAYOUT__NV12,      // Y plane and interleaved UV plane, 8 bit samples
+  PIXEL_LAYOUT__P010,      // Y plane and interleaved UV plane, 16 bit samples, 10 bits used from the top
+
+  NUM_PIXEL_LAYOUTS
+};
+
+struct Pixel_Layout_Info {
+  u32 num_planes;
+  u32 bytes_per_sample;
+  u32 chroma_channels; // 2 when U and V are interleaved in one plane
+  u32 bit_depth;
+  f32 sample_scale; // maps a normalized texture sample back to [0, 1]
+};
+
+enum Color_Matrix {
+  COLOR_MATRIX__BT601,
+  COLOR_MATRIX__BT709,
+  COLOR_MATRIX__BT2020,
+
+  NUM_COLOR_MATRICES
+};
+
+enum Color_Transfer {
+  COLOR_TRANSFER__SDR,    // BT.709/BT.601/sRGB, shown as is
+  COLOR_TRANSFER__LINEAR,
+  COLOR_TRANSFER__PQ,     // SMPTE 2084
+  COLOR_TRANSFER__HLG,    // ARIB STD-B67
+
+  NUM_COLOR_TRANSFERS
+};
+
+// From the stream's color metadata, picks the YUV -> RGB conversion.
+struct Video_Color {
+  Color_Matrix matrix;
+  bool is_full_range;
+  Color_Transfer transfer;
+};
+
+struct Frame_Pool;
+
+// A fixed size frame buffer from a Frame_Pool. Planes start 64 byte aligned
+// and rows are padded to 64 bytes. Goes back to the pool's free list when the
+// last reference is released.
+struct Frame_Buffer {
+  Frame_Pool *pool;
+  u32 index;
+  std::atomic<u32> next; // index + 1 of the next free buffer, 0 ends the list
+  std::atomic<u32> ref_count;
+
+  u8 *planes[3];
+};
+
+// Buffers of one resolution and layout. Taking and returning buffers is a lock
+// free stack, the mutex is only taken to grow the pool.
+struct Frame_Pool {
+  u32 width, height;
+  Pixel_Layout layout;
+  u32 y_stride;
+  u32 uv_stride;
+  u64 buffer_size; // header and planes
+
+  pthread_mutex_t mutex;
+  Arena *arena;
+  std::atomic<u32> num_buffers;
+  Frame_Buffer *buffers[FRAME_POOL_MAX_BUFFERS];
+
+  // index + 1 of the first free buffer in the low bits, a counter bumped on
+  // every change in the high bits so a stale compare exchange fails (ABA)
+  std::atomic<u64> free_head;
+
+  std::atomic<u32> in_use;
+  std::atomic<u64> acquires;
+  std::atomic<u64> exhausted; // acquires that found the pool full
+};
+
+struct Frame_Pools {
+  pthread_mutex_t mutex;
+  std::atomic<u32> count;
+  Frame_Pool pools[FRAME_POOL_MAX_POOLS];
 };
 
 struct Video_Frame_YUV {
   u32 width, height;
+  s64 pts;
+  s64 duration;
+
+  Pixel_Layout layout;
+  Video_Color color;
 
   u8 *y_data;
-  u8 *u_data; // U and V have half width and height
-  u8 *v_data;
+  u8 *u_data; // U and V have half width and height (rounded up), with an interleaved layout u_data holds both
+  u8 *v_data; // NULL with an interleaved layout
+
+  // bytes per row, planes that come straight from the decoder are padded
+  u32 y_stride;
+  u32 uv_stride;
+
+  Frame_Buffer *buffer; // holds the planes if they came from a Frame_Pool, NULL otherwise
+};
+
+struct Keyframe {
+  s64 pts;
+  s64 pos; // byte offset of the packet, -1 if unknown
+};
+
+#define KEYFRAME_INDEX_MAGIC 0x494b4747 // "GGKI"
+#define KEYFRAME_INDEX_VERSION 1
+
+// Stored next to the source as <video file>.kfi
+struct Keyframe_Index_Header {
+  u32 magic;
+  u32 version;
+  s32 stream_index;
+  u32 reserved;
+  s64 source_size; // a sidecar that doesn't match the source is rebuilt
+  s64 source_mtime;
+  u64 count;
+};
+
+// Keyframes of the decoded video stream sorted by pts, built in the background
+// after video_open. Only read once is_ready is set.
+struct Keyframe_Index {
+  pthread_t thread;
+  std::atomic<bool> is_ready;
+  std::atomic<bool> cancel;
+
+  char path[MAX_PATH_LENGTH];
+  s32 stream_index;
+
+  Arena *arena;
+  u64 count;
+  Keyframe *keyframes;
+};
+
+enum Video_Open_Flags {
+  VIDEO_OPEN_FLAG__NONE = 0,
+  VIDEO_OPEN_FLAG__KEYFRAMES_ONLY = (1 << 0), // only decode keyframes, no keyframe index
+  VIDEO_OPEN_FLAG__FULL_QUALITY = (1 << 1), // decode every frame without the preview shortcuts
+  VIDEO_OPEN_FLAG__NO_KEYFRAME_INDEX = (1 << 2), // for sequential reads that never seek far
 };
 
 struct Video {
   // TODO: Look into width and height, maybe have more fields
   // source and dest?
   s32 width, height;
+  u64 source_id; // hash of the path
 
   AVRational time_base;
+  AVRational frame_rate;
+  s64 start_pts;
+  s64 duration_pts;
 
   AVFormatContext *fmt_ctx;
   s32 stream_index;
@@ -68,7 +342,201 @@ struct Video {
 
   AVPacket *packet;
   AVFrame *frame;
-  SwsContext *sws_ctx;
+  SwsContext *sws_ctx; // NULL when the renderer takes the decoder's output as is
+
+  Pixel_Layout layout;
+  Video_Color color;
+
+  s64 decoded_pts; // pts of the last decoded frame, AV_NOPTS_VALUE after a seek
+  Keyframe_Index keyframe_index;
+};
+
+struct Video_Decoder_Slot {
+  Arena *arena; // for converted frames when their frame pool is out of buffers
+  AVFrame *av_frame; // keeps the decoder's buffers alive for native YUV420P frames
+  Video_Frame_YUV frame;
+};
+
+struct Video_Decoder_Stats {
+  u64 presented;
+  u64 dropped;  // decoded but late, never shown
+  u64 repeated; // clock advanced but the next frame wasn't due yet
+  u64 starved;  // clock advanced but the decoder had nothing ready
+};
+
+// Decodes ahead of playback on its own thread. Slots in [read_index, write_index)
+// hold decoded frames, the rest belong to the decoder thread.
+struct Video_Decoder {
+  Video *video;
+
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+
+  bool is_running;
+  bool end_of_stream;
+  bool seek_requested;
+  f64 seek_time;
+  u32 generation; // bumped on seek, frames decoded for an older generation are dropped
+
+  u32 read_index;
+  u32 write_index;
+  Video_Decoder_Slot slots[VIDEO_DECODER_RING_SIZE];
+
+  // only touched by the UI thread
+  s64 target_pts;
+  s64 presented_pts;
+  Video_Decoder_Stats stats;
+};
+
+enum Decoder_Pool_State {
+  DECODER_POOL_STATE__FREE,
+  DECODER_POOL_STATE__OPENING, // waiting for or being opened by the pool thread
+  DECODER_POOL_STATE__READY,   // owned by the UI thread
+  DECODER_POOL_STATE__CLOSING, // waiting for or being closed by the pool thread
+  DECODER_POOL_STATE__FAILED,
+};
+
+// One open Video with its decoder thread, for one timeline clip.
+struct Decoder_Pool_Entry {
+  std::atomic<u32> state;
+
+  u32 clip_id;
+  char path[MAX_PATH_LENGTH];
+  f64 start_sec; // where the decoder starts once it is open
+  f64 preroll_sec; // source time an idle decoder was seeked to ahead of a cut, NAN once presenting
+  u64 last_used; // Decoder_Pool::frame of the last request
+  u64 bytes; // estimate of the decoded frames the decoder holds, known once READY
+  bool is_budgeted; // bytes were counted against the budget after the open
+
+  Video video;
+  Video_Decoder decoder;
+};
+
+// Keeps Video contexts open for the clips around the playhead. Opening and
+// closing happen on the pool thread, idle entries are evicted least recently
+// used first when the number of open entries or their memory is over budget.
+struct Decoder_Pool {
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  bool is_running;
+
+  s32 max_open;
+  u64 budget;
+  u64 frame;
+
+  Decoder_Pool_Entry entries[DECODER_POOL_MAX_ENTRIES];
+
+  u64 opens;
+  u64 evictions;
+  u64 not_ready; // requests for an entry that wasn't open yet
+};
+
+struct Playback_Stats {
+  u64 cuts; // clip changes at the playhead while playing
+  u64 cut_hitches; // cuts where the first frame of the new clip wasn't ready
+  u64 prerolled; // frames uploaded ahead of a cut
+};
+
+struct Thumbnail {
+  std::atomic<bool> is_ready; // pixels written by the generator thread
+  bool is_uploaded;
+};
+
+// Keyframe thumbnails sampled evenly over a source, packed into one atlas texture.
+// The generator thread fills the staging pixels, the UI thread uploads them.
+struct Thumbnail_Strip {
+  pthread_t thread;
+  std::atomic<bool> cancel;
+
+  char path[MAX_PATH_LENGTH];
+  u64 source_id;
+  f64 duration;
+  f64 interval; // seconds between thumbnails
+  u32 width, height; // of one thumbnail
+  u32 columns;
+  u32 count;
+
+  Arena *arena;
+  u8 *pixels; // count thumbnails of width x height RGBA
+  Thumbnail *thumbnails;
+  u32 num_uploaded;
+
+  u32 atlas_tex;
+};
+
+// Single producer (audio decoder thread), single consumer (output callback).
+// Positions count frames of AUDIO_OUTPUT_CHANNELS interleaved f32 samples.
+struct Audio_Ring {
+  f32 *samples;
+  std::atomic<u64> read_pos;
+  std::atomic<u64> write_pos;
+};
+
+enum Audio_Sink_Type {
+  AUDIO_SINK__NULL,   // consumes samples in real time and throws them away
+  AUDIO_SINK__WAV,    // consumes samples in real time into a wav file
+  AUDIO_SINK__DEVICE, // sound hardware
+  NUM_AUDIO_SINKS,
+};
+
+struct Audio_Output {
+  Audio_Sink_Type sink;
+
+  std::atomic<bool> is_running;
+  std::atomic<bool> is_playing;
+
+  // null and wav sinks are driven by their own thread
+  pthread_t thread;
+  FILE *wav_file;
+  u64 wav_frames;
+
+  void *device; // AudioQueueRef
+
+  // clock, owned by the output callback
+  std::atomic<u32> seen_seek_serial;
+  std::atomic<f64> clock_base; // source time of the first frame played after the last seek
+  std::atomic<u64> frames_played;
+  std::atomic<u64> underruns;
+};
+
+// Decodes and resamples the audio stream of a source on its own thread and
+// plays it through an Audio_Output. While playing, its clock is the master
+// clock that Sequencer::playback_time follows.
+struct Audio {
+  bool has_stream;
+  char path[MAX_PATH_LENGTH];
+
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  std::atomic<bool> is_running;
+  bool end_of_stream;
+
+  AVFormatContext *fmt_ctx;
+  AVCodecContext *codec_ctx;
+  SwrContext *swr_ctx;
+  AVPacket *packet;
+  AVFrame *frame;
+  s32 stream_index;
+  AVRational time_base;
+  s64 start_pts;
+  f64 decode_seek_time; // target of the last seek the decoder thread handled
+  s64 drop_until; // output frames still to drop to land exactly on decode_seek_time
+
+  Arena *arena;
+  f32 *chunk; // AUDIO_MAX_CHUNK_FRAMES resampled frames
+  Audio_Ring ring;
+  Audio_Output output;
+
+  // seek handshake: the UI requests, the decoder thread repositions the ring,
+  // the output callback picks up the new ring position and clock
+  u32 seek_requested_serial; // guarded by mutex
+  f64 seek_time;
+  std::atomic<u32> seek_serial;
+  std::atomic<u64> seek_ring_pos;
+  std::atomic<f64> seek_clock_base;
+  std::atomic<bool> is_drained; // end of stream and everything played
 };
 
 struct Video_Fetcher {
@@ -99,6 +567,96 @@ struct Video_Lister {
   Video_Source sources[1024];
 };
 
+#define TIMELINE_MAX_TRACKS 16
+
+// Places a clip's frame in the output. Without a transform the frame is
+// centered and fitted (or filled) to the project size.
+struct Layer_Transform {
+  f32 x, y;     // offset of the center, in fractions of the output size, y down
+  f32 scale;
+  f32 rotation; // degrees, clockwise
+  f32 crop[4];  // left, top, right, bottom, in fractions of the frame
+  f32 opacity;
+};
+
+enum Effect_Type {
+  EFFECT_TYPE__COLOR,   // exposure, contrast, saturation, temperature
+  EFFECT_TYPE__BLUR,    // radius in fractions of the frame height
+  EFFECT_TYPE__SHARPEN, // amount
+  EFFECT_TYPE__LUT,     // mix, Effect::lut picks the table
+
+  NUM_EFFECT_TYPES
+};
+
+struct Effect {
+  Effect_Type type;
+  bool is_enabled;
+  u32 lut; // index into Renderer::luts
+  f32 params[4];
+};
+
+// Effects run in order on the clip's frame before it is composited.
+struct Effect_Chain {
+  Effect effects[EFFECT_CHAIN_MAX];
+  u32 num_effects;
+};
+
+struct Timeline_Source {
+  u64 id; // same hash as Video::source_id
+  char path[MAX_PATH_LENGTH];
+  f64 duration;
+
+  bool has_proxy; // proxy_path exists and is newer than the source
+  char proxy_path[MAX_PATH_LENGTH];
+};
+
+struct Timeline_Clip {
+  u32 id; // stable across edits, unlike the clip's index
+  u32 source; // index into Timeline::sources
+  u32 track;  // higher tracks are drawn over lower ones
+  f64 start;  // position on the timeline
+  f64 in_point; // source time shown at start
+  f64 out_point;
+
+  Layer_Transform transform;
+  Effect_Chain effects;
+};
+
+// One node of the implicit interval tree, sorted by start. max_end is the
+// largest end in the node's subtree, see timeline_index_build.
+struct Timeline_Interval {
+  f64 start, end;
+  f64 max_end;
+  u32 clip;
+};
+
+struct Timeline_Track {
+  char name[32];
+  bool is_hidden;
+};
+
+// Clips live in a contiguous arena-backed array, unordered. The interval
+// index over them is rebuilt lazily on the first query after an edit.
+struct Timeline {
+  Arena *sources_arena;
+  Timeline_Source *sources;
+  u32 num_sources;
+
+  Arena *clips_arena;
+  Timeline_Clip *clips;
+  u32 num_clips;
+  u32 next_clip_id;
+
+  u32 num_tracks;
+  Timeline_Track tracks[TIMELINE_MAX_TRACKS];
+
+  Arena *index_arena;
+  Timeline_Interval *intervals;
+  u32 *query_results; // num_clips entries, overwritten by every query
+  s32 index_levels;
+  bool is_index_dirty;
+};
+
 struct Sequencer_Theme {
   ImColor text;
   ImColor background;
@@ -119,6 +677,7 @@ struct Sequencer {
   f32 pan;
 
   f32 timeline_height;
+  f32 track_height;
   f32 lister_width;
   f32 border_width;
 
@@ -129,7 +688,134 @@ struct Sequencer {
 
 struct YUV_Texture {
   u32 width, height;
-  u32 ids[3];
+  Pixel_Layout layout;
+  Video_Color color; // of the last uploaded frame
+  u32 ids[3]; // unused planes are 0
+};
+
+// Pixel unpack buffers shared by all texture uploads, uploads rotate through
+// them so a transfer never waits on the previous one.
+struct Upload_Ring {
+  u32 pbos[UPLOAD_RING_SIZE][3];
+  u64 sizes[UPLOAD_RING_SIZE][3];
+  u32 index;
+};
+
+// Pixel pack buffers the render target is read back into. Each readback is
+// fenced and only mapped once the GPU has finished writing it, frames come
+// out READBACK_RING_SIZE - 1 frames later.
+struct Readback_Ring {
+  u32 width, height;
+  u32 pbos[READBACK_RING_SIZE];
+  GLsync fences[READBACK_RING_SIZE];
+  u32 read_index, write_index;
+  u64 stalls; // maps that had to wait for the GPU
+};
+
+struct Frame_Cache_Entry {
+  bool is_used;
+  u64 source_id;
+  s64 pts;
+  s64 duration;
+
+  YUV_Texture texture;
+  u64 bytes;
+
+  // least recently used list
+  Frame_Cache_Entry *prev;
+  Frame_Cache_Entry *next;
+};
+
+// Decoded frames kept on the gpu, keyed by source and pts. Showing a cached
+// frame again is only a texture bind.
+struct Frame_Cache {
+  u64 budget;
+  u64 bytes_used;
+  u32 count;
+
+  Frame_Cache_Entry *most_recent;
+  Frame_Cache_Entry *least_recent;
+  Frame_Cache_Entry entries[FRAME_CACHE_MAX_ENTRIES];
+
+  u64 hits;
+  u64 misses;
+  u64 evictions;
+};
+
+enum Encoder_Preset {
+  ENCODER_PRESET__EXPORT, // h264 (x264 if available), long GOP
+  ENCODER_PRESET__PROXY,  // mjpeg, every frame a keyframe
+};
+
+struct Encoder_Params {
+  Encoder_Preset preset;
+  u32 width, height;
+  AVRational frame_rate;
+  AVRational time_base; // of the pts passed to encoder_write_frame, 1/frame_rate if zero
+};
+
+struct Encoder {
+  AVFormatContext *fmt_ctx;
+  AVCodecContext *codec_ctx;
+  AVStream *stream;
+  AVFrame *frame;
+  AVPacket *packet;
+  SwsContext *sws_ctx; // whatever comes in -> the encoder's pixel format and size
+
+  u32 width, height;
+  s64 frame_index;
+};
+
+struct Export_Params {
+  char input_paths[EXPORT_MAX_INPUTS][MAX_PATH_LENGTH]; // laid end to end on one track by the command line export
+  u32 num_inputs;
+  char output_path[MAX_PATH_LENGTH];
+  char captions_path[MAX_PATH_LENGTH]; // empty for none
+  u32 width, height;
+  f64 start_time;
+  f64 end_time; // <= 0 exports to the end of the timeline
+};
+
+// A timeline clip being decoded by an export, opened when it becomes visible
+// and closed once it isn't anymore.
+struct Export_Clip {
+  u32 clip_id;
+  bool is_used;
+  bool is_failed; // couldn't be opened, left out of the export
+  bool is_visible; // at the current output frame
+  bool end_of_stream;
+  bool has_texture;
+  // end of the last decoded frame in source pts, kept here because native
+  // layouts move the frame out of video->frame into the slot
+  s64 decoded_end;
+
+  Video video;
+  Video_Decoder_Slot slot;
+  YUV_Texture texture;
+};
+
+struct Scopes {
+  bool is_enabled;
+  Readback_Ring readback;
+  f32 histogram[256]; // luma, normalized to the highest bin
+};
+
+// Transcodes sources into small all-intra proxies on its own thread, one job
+// at a time. A proxy is written next to its source as <video file>.proxy.mov.
+struct Proxy_Generator {
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  bool is_running;
+  std::atomic<bool> cancel; // stops the current job
+
+  char jobs[PROXY_MAX_JOBS][MAX_PATH_LENGTH];
+  u32 num_jobs;
+  u32 next_job;
+
+  std::atomic<u32> num_done; // bumped whenever a proxy was written
+  std::atomic<u32> num_failed;
+  std::atomic<f32> progress; // of the current job
 };
 
 struct Render_Target {
@@ -138,13 +824,235 @@ struct Render_Target {
   u32 tex;
 };
 
+// How a frame with another aspect ratio is placed in the render target.
+enum Fit_Mode {
+  FIT_MODE__FIT,  // all of the frame is visible, with bars
+  FIT_MODE__FILL, // the frame covers the target and is cropped
+
+  NUM_FIT_MODES
+};
+
+// Output settings of the project. The preview renders at a fraction of the
+// output resolution while playing and at full resolution when paused.
+struct Project_Settings {
+  u32 width, height;
+  Fit_Mode fit_mode;
+  f32 playback_scale;
+  f32 paused_scale;
+};
+
+// The YUV -> RGB program, its uniform locations are looked up once after linking.
+struct YUV_Shader {
+  u32 program;
+
+  s32 draw_color;
+  s32 is_interleaved;
+  s32 sample_scale;
+  s32 yuv_to_rgb;
+  s32 yuv_offset;
+  s32 transfer;
+  s32 is_rgb;
+};
+
+// What a shader pass does with its neighbourhood. Per pixel effects have no
+// kernel of their own, they are fused into the pass before them.
+enum Effect_Kernel {
+  EFFECT_KERNEL__COPY,
+  EFFECT_KERNEL__BLUR_X,
+  EFFECT_KERNEL__BLUR_Y,
+  EFFECT_KERNEL__SHARPEN,
+
+  NUM_EFFECT_KERNELS
+};
+
+// One draw of an effect chain from one intermediate target into the other.
+struct Effect_Pass {
+  Effect_Kernel kernel;
+  f32 strength; // blur radius in fractions of the frame height, or sharpen amount
+  s32 color; // fused COLOR effect applied after the kernel, -1 for none
+  s32 lut;   // fused LUT effect applied after color, -1 for none
+};
+
+struct Effect_Shader {
+  u32 program;
+
+  s32 kernel;
+  s32 texel_size;
+  s32 strength;
+  s32 has_color;
+  s32 color_params;
+  s32 has_lut;
+  s32 lut_size;
+  s32 lut_mix;
+};
+
+struct Effect_Lut {
+  char name[64];
+  u32 texture; // 3D, RGB
+  u32 size;
+};
+
+// Intermediate targets are borrowed for one frame and kept for the next, so
+// effects don't create textures while playing or exporting.
+struct Render_Target_Pool {
+  Render_Target targets[RENDER_TARGET_POOL_SIZE];
+  bool in_use[RENDER_TARGET_POOL_SIZE];
+  u32 created; // targets created since init, settles once the sizes in use are pooled
+};
+
+struct Render_Layer {
+  YUV_Texture texture;
+  Layer_Transform transform;
+  Effect_Chain effects;
+  s32 depth; // layers are drawn from low to high depth
+
+  s32 effect_output; // pooled target holding the frame after its effects, -1 for none
+};
+
+struct Layer_Vertex {
+  f32 x, y;
+  f32 u, v;
+  f32 opacity;
+};
+
+struct Renderer_Stats {
+  u32 layers;
+  u32 draw_calls;
+  u32 texture_binds;
+  u32 color_changes; // layers whose color conversion differed from the one before
+  u32 effect_passes;
+  u32 fused_effects; // effects that ran inside another effect's pass
+};
+
 struct Renderer {
-  u32 shader_program;
+  YUV_Shader yuv_shader;
   Render_Target target;
+  Upload_Ring upload_ring;
+
+  Effect_Shader effect_shader;
+  Render_Target_Pool target_pool;
+  Effect_Lut luts[EFFECT_MAX_LUTS];
+  u32 num_luts;
 
-  u32 vao, vbo, ibo;
+  // every layer's quad goes into the one vertex buffer, 6 vertices each,
+  // followed by a quad covering the whole target for effect passes
+  u32 vao, vbo;
+  Render_Layer layers[RENDERER_MAX_LAYERS];
+  u32 num_layers;
+  Renderer_Stats stats; // of the last composited frame
 
+  Fit_Mode fit_mode;
   float draw_color[3];
+
+  // debug override of the color metadata of every drawn frame
+  bool is_color_overridden;
+  Video_Color color_override;
+};
+
+struct Glyph {
+  u32 codepoint; // 0 marks an empty slot
+  u16 x, y, width, height; // rect in the atlas, empty for blank glyphs
+  f32 x_offset, y_offset; // from the pen to the rect's top left
+  f32 advance;
+};
+
+// Glyphs of one font, rasterized as signed distance fields the first time
+// they are drawn and packed into one texture row by row.
+struct Glyph_Atlas {
+  Arena *arena; // holds the font file
+  stbtt_fontinfo font;
+  f32 scale; // font units to pixels at GLYPH_PIXEL_HEIGHT
+  f32 ascent, descent, line_gap; // pixels at GLYPH_PIXEL_HEIGHT
+
+  u32 texture;
+  u32 pen_x, pen_y, row_height;
+  bool is_full;
+
+  Glyph glyphs[GLYPH_CACHE_SIZE];
+  u32 num_glyphs;
+};
+
+struct Text_Vertex {
+  f32 x, y;
+  f32 u, v;
+  u32 color; // RGBA8
+};
+
+struct Text_Shader {
+  u32 program;
+
+  s32 atlas;
+  s32 outline_color;
+  s32 outline_width;
+};
+
+struct Text_Stats {
+  u32 glyphs;
+  u32 draw_calls;
+  u32 rasterized; // glyphs added to the atlas
+};
+
+// Collects the quads of any number of strings and draws them with one draw
+// call, all glyphs come from the one atlas.
+struct Text_Renderer {
+  bool is_loaded;
+  Text_Shader shader;
+  Glyph_Atlas atlas;
+
+  u32 vao, vbo;
+  Arena *arena;
+  Text_Vertex *vertices;
+  u32 num_vertices;
+
+  Text_Stats stats; // of the last flush
+};
+
+struct Caption_Word {
+  f64 start, end; // timeline seconds
+  u32 text_offset; // into Captions::text
+  u32 text_length;
+};
+
+// A block is shown as a whole from its first word's start to its last word's end.
+struct Caption_Block {
+  f64 start, end;
+  u32 first_word;
+  u32 num_words;
+};
+
+struct Caption_Style {
+  f32 size;      // text height, in fractions of the output height
+  f32 y;         // center of the block, in fractions of the output height
+  f32 max_width; // lines wrap at this fraction of the output width
+  u32 color;           // RGBA8 of spoken words
+  u32 upcoming_color;  // RGBA8 of words that are not spoken yet
+  u32 highlight_color; // RGBA8 of the word being spoken
+  f32 outline_color[4];
+  f32 outline_width; // in distance field units, 0.5 is the whole padding
+  f32 pop; // extra scale of the spoken word as it starts
+};
+
+struct Captions {
+  bool is_enabled;
+  Arena *arena;
+  Caption_Block *blocks; // sorted by start
+  u32 num_blocks;
+  Caption_Word *words;
+  u32 num_words;
+  char *text;
+  u32 text_size;
+
+  Caption_Style style;
+  Text_Renderer text_renderer;
+};
+
+struct Preview_Layer {
+  Timeline_Clip clip;
+  Frame_Cache_Entry *frame; // NULL until the clip's decoder delivered a frame
+  // what frame held when it was presented, the cache may recycle the entry
+  // for another frame while the layer still points at it
+  u64 source_id;
+  s64 pts;
 };
 
 struct App {
@@ -153,11 +1061,27 @@ struct App {
   Video_Fetcher vid_fetcher;
   Video_Lister vid_lister;
 
-  Arena *video_arena;
-  Video video;
+  Decoder_Pool decoder_pool;
+  Decoder_Pool_Entry *active_entry; // decoder of the clip at the playhead
+  u32 active_clip_id;
+  Playback_Stats playback_stats;
+  Thumbnail_Strip thumbnails;
+  Audio audio;
+  f64 audio_synced_time; // playback time after the last audio clock sync
 
+  Timeline timeline;
   Sequencer sequencer;
 
-  YUV_Texture video_texture;
+  Project_Settings project;
+  Captions captions;
+
+  Proxy_Generator proxies;
+  bool use_proxies; // preview only, export always decodes the originals
+  u32 proxies_seen_done;
+
+  Frame_Cache frame_cache;
+  Preview_Layer layers[RENDERER_MAX_LAYERS]; // visible clips at the playhead, bottom to top
+  u32 num_layers;
   Renderer renderer;
+  Scopes scopes;
 };
\ No newline at end of file
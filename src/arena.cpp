@@ -1,10 +1,149 @@
+#include <sys/resource.h>
+
 
 #define push_array_no_zero_aligned(a, T, c, align) (T *)arena_push((a), sizeof(T)*(c), (align))
 #define push_array_aligned(a, T, c, align) (T *)memset(push_array_no_zero_aligned(a, T, c, align), 0, sizeof(T)*(c))
 #define push_array_no_zero(a, T, c) push_array_no_zero_aligned(a, T, c, Max(8, __alignof(T)))
 #define push_array(a, T, c) push_array_aligned(a, T, c, Max(8, __alignof(T)))
 
-static Arena *arena_alloc(Arena_Params params) {
+static Arena_Freelist arena_freelist = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+static Arena_Stats arena_stats;
+static Arena_Registry arena_registry = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+// Single writer, so a load and a store are enough and pushes don't pay for a locked add.
+static inline void arena_info_add(std::atomic<u64> *value, std::atomic<u64> *peak, u64 amount) {
+  u64 result = value->load(std::memory_order_relaxed) + amount;
+  value->store(result, std::memory_order_relaxed);
+  if (peak && result > peak->load(std::memory_order_relaxed)) {
+    peak->store(result, std::memory_order_relaxed);
+  }
+}
+
+static inline void arena_info_sub(std::atomic<u64> *value, u64 amount) {
+  value->store(value->load(std::memory_order_relaxed) - amount, std::memory_order_relaxed);
+}
+
+static void arena_info_add_block(Arena_Info *info, Arena *block) {
+  if (info) {
+    arena_info_add(&info->reserved, NULL, block->res);
+    arena_info_add(&info->committed, &info->peak_committed, block->cmt);
+    arena_info_add(&info->resident, &info->peak_resident, block->high_water);
+    info->num_blocks.store(info->num_blocks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+}
+
+static inline u64 arena_page_size(Arena *block) {
+  return block->flags & ARENA_FLAG__LARGE_PAGES ? MiB(2) : (u64)getpagesize();
+}
+
+// Drops the resident pages of the block past pos. They stay committed, the
+// next touch faults in a zeroed page. Costs nothing when none were touched.
+static void arena_decommit(Arena *block, u64 pos) {
+  pos = Clamp((u64)ARENA_HEADER_SIZE, pos, block->res);
+  u64 keep = AlignPow2(pos, arena_page_size(block));
+  u64 end = Min(AlignPow2(block->high_water, arena_page_size(block)), block->cmt);
+  bool is_dropped = true;
+  if (end > keep) {
+#ifdef __APPLE__
+    // MADV_DONTNEED leaves anonymous pages resident on Darwin, mapping fresh
+    // pages over the range frees them and keeps it committed
+    void *remapped = mmap((u8 *)block + keep, end - keep, PROT_READ|PROT_WRITE,
+                          MAP_FIXED|MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    is_dropped = remapped != MAP_FAILED;
+#else
+    // hugetlb ranges reject MADV_DONTNEED before Linux 5.18, their pages stay
+    is_dropped = madvise((u8 *)block + keep, end - keep, MADV_DONTNEED) == 0;
+#endif
+    if (is_dropped) arena_stats.decommitted += end - keep;
+  }
+  if (is_dropped && block->high_water > keep) {
+    if (block->info) arena_info_sub(&block->info->resident, block->high_water - keep);
+    block->high_water = keep;
+  }
+}
+
+// Takes a released block reserving exactly reserve_size, NULL if there is none.
+static Arena *arena_freelist_take(u64 reserve_size, Arena_Flags flags) {
+  Arena *result = NULL;
+
+  pthread_mutex_lock(&arena_freelist.mutex);
+  for (Arena **it = &arena_freelist.last; *it != NULL; it = &(*it)->prev) {
+    Arena *block = *it;
+    if (block->res == reserve_size && (block->flags & ARENA_FLAG__LARGE_PAGES) == (flags & ARENA_FLAG__LARGE_PAGES)) {
+      *it = block->prev;
+      arena_freelist.size -= block->res;
+      result = block;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&arena_freelist.mutex);
+
+  return result;
+}
+
+// Keeps the block for another arena, unless the freelist is full. Its pages
+// are dropped first, a released arena shouldn't keep memory resident.
+static void arena_freelist_give(Arena *block) {
+  block->info = NULL;
+  arena_decommit(block, 0);
+
+  bool is_kept = false;
+
+  pthread_mutex_lock(&arena_freelist.mutex);
+  if (arena_freelist.size + block->res <= ARENA_FREELIST_MAX_BYTES) {
+    block->prev = arena_freelist.last;
+    arena_freelist.last = block;
+    arena_freelist.size += block->res;
+    is_kept = true;
+  }
+  pthread_mutex_unlock(&arena_freelist.mutex);
+
+  if (!is_kept) {
+    munmap(block, block->res);
+    arena_stats.unmaps++;
+  }
+}
+
+// Reserves address space for a block. Large pages come from the hugetlb pool
+// when it has enough free, otherwise the range is 2 MiB aligned and handed to
+// transparent huge pages.
+static void *arena_map(u64 reserve_size, Arena_Flags flags) {
+  void *result = NULL;
+
+  if (flags & ARENA_FLAG__LARGE_PAGES) {
+#ifdef MAP_HUGETLB
+    result = mmap(0, reserve_size, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+    if (result == MAP_FAILED) {
+      result = NULL;
+    } else {
+      arena_stats.huge_maps++;
+    }
+#endif
+
+    if (result == NULL) {
+      u64 alignment = MiB(2);
+      u8 *mapped = (u8 *)mmap(0, reserve_size + alignment, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+      if (mapped != MAP_FAILED) {
+        u8 *aligned = (u8 *)AlignPow2((u64)mapped, alignment);
+        u64 head = aligned - mapped;
+        u64 tail = alignment - head;
+        if (head > 0) munmap(mapped, head);
+        if (tail > 0) munmap(aligned + reserve_size, tail);
+#ifdef MADV_HUGEPAGE
+        madvise(aligned, reserve_size, MADV_HUGEPAGE);
+#endif
+        result = aligned;
+      }
+    }
+  } else {
+    result = mmap(0, reserve_size, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (result == MAP_FAILED) result = NULL;
+  }
+
+  return result;
+}
+
+static Arena *arena_alloc_block(Arena_Params params) {
   u64 reserve_size = params.reserve_size;
   u64 commit_size = params.commit_size;
 
@@ -18,29 +157,96 @@ static Arena *arena_alloc(Arena_Params params) {
   }
 
   void *base = params.optional_backing_buffer;
+  u64 committed = commit_size;
+  u64 high_water = ARENA_HEADER_SIZE;
   if (base == NULL) {
-    /*MAP_HUGETLB*/
-    base = mmap(0, reserve_size, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
-    mprotect(base, commit_size, PROT_READ|PROT_WRITE);
+    Arena *reused = arena_freelist_take(reserve_size, params.flags);
+    if (reused) {
+      // its pages stay committed, only commit what is missing
+      if (reused->cmt < commit_size) {
+        mprotect(reused, commit_size, PROT_READ|PROT_WRITE);
+      }
+      committed = Max(commit_size, reused->cmt);
+      high_water = reused->high_water;
+      base = reused;
+      arena_stats.reuses++;
+    } else {
+      base = arena_map(reserve_size, params.flags);
+      mprotect(base, commit_size, PROT_READ|PROT_WRITE);
+      arena_stats.fresh_maps++;
+    }
   }
 
   Arena *arena = (Arena *)base;
+  arena->prev = NULL;
   arena->current = arena;
   arena->flags = params.flags;
-  arena->cmt_size = (u32)params.commit_size;
+  arena->cmt_size = (u32)commit_size;
   arena->res_size = params.reserve_size;
   arena->base_pos = 0;
   arena->pos = ARENA_HEADER_SIZE;
-  arena->cmt = commit_size;
+  arena->cmt = committed;
   arena->res = reserve_size;
+  arena->free_last = NULL;
+  arena->free_size = 0;
+  arena->high_water = high_water;
+  arena->decommit_threshold = params.decommit_threshold ? params.decommit_threshold : ARENA_DEFAULT_DECOMMIT_THRESHOLD;
+  if (params.optional_backing_buffer) {
+    // not ours to give back
+    arena->decommit_threshold = reserve_size;
+  }
+  arena->info = NULL;
 
   return arena;
 }
 
+static Arena *arena_alloc(Arena_Params params) {
+  Arena *arena = arena_alloc_block(params);
+
+  // the memory window walks the used slots under the mutex, a slot is only
+  // marked used once its name and counters are set
+  pthread_mutex_lock(&arena_registry.mutex);
+  for (u32 i = 0; i < ARENA_REGISTRY_SIZE; ++i) {
+    Arena_Info *info = &arena_registry.infos[i];
+    if (!info->is_used) {
+      info->name = params.name ? params.name : "unnamed";
+      info->reserved = 0;
+      info->committed = 0;
+      info->resident = 0;
+      info->used = 0;
+      info->peak_committed = 0;
+      info->peak_resident = 0;
+      info->peak_used = 0;
+      info->num_blocks = 0;
+      info->pushes = 0;
+      arena_info_add_block(info, arena);
+      info->is_used = true;
+      arena->info = info;
+      break;
+    }
+  }
+  if (arena->info == NULL) arena_registry.untracked++;
+  pthread_mutex_unlock(&arena_registry.mutex);
+
+  return arena;
+}
+
+// Hands every block to the global freelist. The chain starts at the current
+// block, the first one (arena itself) holds free_last and goes last.
 static void arena_release(Arena *arena) {
-  for (Arena *n = arena, *prev = 0; n != 0; n = prev) {
+  if (arena->info) {
+    pthread_mutex_lock(&arena_registry.mutex);
+    arena->info->is_used = false;
+    pthread_mutex_unlock(&arena_registry.mutex);
+  }
+
+  for (Arena *n = arena->free_last, *prev = 0; n != 0; n = prev) {
+    prev = n->prev;
+    arena_freelist_give(n);
+  }
+  for (Arena *n = arena->current, *prev = 0; n != 0; n = prev) {
     prev = n->prev;
-    munmap(n, n->res);
+    arena_freelist_give(n);
   }
 }
 
@@ -52,7 +258,21 @@ static void *arena_push(Arena *arena, u64 size, u64 align) {
   if (pos_pst > current->res && !(arena->flags & ARENA_FLAG__NO_CHAIN)) {
     Arena *new_block = NULL;
 
-    // freelist?
+    // blocks popped earlier are still mapped and committed
+    for (Arena *block = arena->free_last, *next = NULL; block != NULL; next = block, block = block->prev) {
+      if (block->res >= AlignPow2(ARENA_HEADER_SIZE, align) + size) {
+        if (next) next->prev = block->prev;
+        else arena->free_last = block->prev;
+        arena->free_size -= block->res;
+        arena_stats.reuses++;
+        new_block = block;
+        if (arena->info) {
+          arena->info->num_blocks.store(arena->info->num_blocks.load(std::memory_order_relaxed) + 1,
+                                        std::memory_order_relaxed);
+        }
+        break;
+      }
+    }
 
     if (new_block == NULL) {
       u64 res_size = current->res_size;
@@ -61,14 +281,18 @@ static void *arena_push(Arena *arena, u64 size, u64 align) {
         res_size = AlignPow2(size + ARENA_HEADER_SIZE, align);
         cmt_size = AlignPow2(size + ARENA_HEADER_SIZE, align);
       }
-      new_block = arena_alloc({
+      new_block = arena_alloc_block({
         .flags = current->flags,
         .reserve_size = res_size,
         .commit_size = cmt_size,
+        .decommit_threshold = current->decommit_threshold,
       });
-      new_block->base_pos = current->base_pos + current->res;
+      new_block->info = arena->info;
+      arena_info_add_block(arena->info, new_block);
     }
 
+    new_block->base_pos = current->base_pos + current->res;
+    new_block->pos = ARENA_HEADER_SIZE;
     new_block->prev = arena->current;
     arena->current = new_block;
 
@@ -87,12 +311,27 @@ static void *arena_push(Arena *arena, u64 size, u64 align) {
     mprotect(cmt_ptr, cmt_size, PROT_READ|PROT_WRITE); // alt. commit large (on non mac platforms)
 
     current->cmt = cmt_pst_clamped;
+    if (arena->info) arena_info_add(&arena->info->committed, &arena->info->peak_committed, cmt_size);
   }
 
   void *result = NULL;
   if (current->cmt >= pos_pst) {
     result = (u8 *)current + pos_pre;
     current->pos = pos_pst;
+
+    Arena_Info *info = arena->info;
+    if (pos_pst > current->high_water) {
+      if (info) arena_info_add(&info->resident, &info->peak_resident, pos_pst - current->high_water);
+      current->high_water = pos_pst;
+    }
+    if (info) {
+      u64 used = current->base_pos + pos_pst;
+      info->used.store(used, std::memory_order_relaxed);
+      if (used > info->peak_used.load(std::memory_order_relaxed)) {
+        info->peak_used.store(used, std::memory_order_relaxed);
+      }
+      info->pushes.store(info->pushes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
   }
 
   return result;
@@ -104,18 +343,43 @@ static u64 arena_pos(Arena *arena) {
   return pos;
 }
 
+// Pops back to pos. What the arena used before the pop, or at least the
+// decommit threshold, stays resident, the rest of the pages are given back.
+// A pop every frame settles on last frame's usage and doesn't decommit,
+// a single larger frame (a 4K clip) is only kept until the next pop.
 static void arena_pop_to(Arena *arena, u64 pos) {
   u64 big_pos = ClampBot(pos, ARENA_HEADER_SIZE);
+  u64 old_pos = arena_pos(arena);
   Arena *current = arena->current;
 
+  // blocks still on the freelist weren't needed since the last pop
+  for (Arena *block = arena->free_last; block != NULL; block = block->prev) {
+    arena_decommit(block, 0);
+  }
+
+  // popped blocks keep their pages for the next time the arena grows,
+  // resetting an arena every frame doesn't go through the kernel
+  u32 num_popped = 0;
   for (Arena *prev = 0; current->base_pos >= big_pos; current = prev) {
     prev = current->prev;
-    munmap(current, current->res);
+    current->prev = arena->free_last;
+    arena->free_last = current;
+    arena->free_size += current->res;
+    num_popped++;
   }
 
   arena->current = current;
   u64 new_pos = big_pos - current->base_pos;
   current->pos = new_pos;
+
+  if (arena->info) {
+    arena->info->used.store(big_pos, std::memory_order_relaxed);
+    arena->info->num_blocks.store(arena->info->num_blocks.load(std::memory_order_relaxed) - num_popped,
+                                  std::memory_order_relaxed);
+  }
+
+  u64 used = Min(old_pos - current->base_pos, current->res);
+  arena_decommit(current, Max(used, arena->decommit_threshold));
 }
 
 static void arena_clear(Arena *arena) {
@@ -132,3 +396,193 @@ static void arena_pop(Arena *arena, u64 amt) {
   }
   arena_pop_to(arena, new_pos);
 }
+
+static Temp temp_begin(Arena *arena) {
+  Temp result = { arena, arena_pos(arena) };
+  return result;
+}
+
+static void temp_end(Temp temp) {
+  arena_pop_to(temp.arena, temp.pos);
+}
+
+// Per thread arenas for memory that doesn't outlive a function, created on first use.
+static thread_local Arena *scratch_arenas[SCRATCH_ARENA_COUNT];
+
+// Returns a scratch arena that is none of the conflicts, which are arenas the
+// caller is already allocating from (its own result arena or a scratch arena
+// it got from its caller). Everything pushed is popped by scratch_end.
+// There are only SCRATCH_ARENA_COUNT scratch arenas, if all of them are
+// conflicts that's a bug in the caller and we abort.
+static Temp scratch_begin(Arena **conflicts, u32 num_conflicts) {
+  Arena *result = NULL;
+  for (u32 i = 0; i < SCRATCH_ARENA_COUNT && result == NULL; ++i) {
+    if (scratch_arenas[i] == NULL) {
+      scratch_arenas[i] = arena_alloc((Arena_Params){
+        .name = "scratch",
+        .reserve_size = SCRATCH_ARENA_RESERVE_SIZE,
+        .commit_size = SCRATCH_ARENA_COMMIT_SIZE,
+      });
+    }
+
+    bool is_conflict = false;
+    for (u32 j = 0; j < num_conflicts && !is_conflict; ++j) {
+      is_conflict = conflicts[j] == scratch_arenas[i];
+    }
+    if (!is_conflict) result = scratch_arenas[i];
+  }
+
+  if (result == NULL) {
+    fprintf(stderr, "scratch_begin: all %d scratch arenas are conflicts\n", SCRATCH_ARENA_COUNT);
+    abort();
+  }
+
+  return temp_begin(result);
+}
+
+static void scratch_end(Temp scratch) {
+  temp_end(scratch);
+}
+
+// Called by threads before they exit, their scratch arenas go back to the freelist.
+static void scratch_release_thread() {
+  for (u32 i = 0; i < SCRATCH_ARENA_COUNT; ++i) {
+    if (scratch_arenas[i]) {
+      arena_release(scratch_arenas[i]);
+      scratch_arenas[i] = NULL;
+    }
+  }
+}
+
+// Sums the tracked arenas by name, largest peak resident first.
+static u32 arena_collect_groups(Arena_Group *groups, u32 max_groups) {
+  u32 result = 0;
+
+  // keeps slots from being handed to new arenas while they are read
+  pthread_mutex_lock(&arena_registry.mutex);
+  for (u32 i = 0; i < ARENA_REGISTRY_SIZE; ++i) {
+    Arena_Info *info = &arena_registry.infos[i];
+    if (!info->is_used) continue;
+
+    Arena_Group *group = NULL;
+    for (u32 j = 0; j < result && group == NULL; ++j) {
+      if (strcmp(groups[j].name, info->name) == 0) group = &groups[j];
+    }
+    if (group == NULL) {
+      if (result == max_groups) continue;
+      group = &groups[result++];
+      *group = {0};
+      group->name = info->name;
+    }
+
+    group->count++;
+    group->num_blocks += info->num_blocks.load(std::memory_order_relaxed);
+    group->reserved += info->reserved.load(std::memory_order_relaxed);
+    group->committed += info->committed.load(std::memory_order_relaxed);
+    group->resident += info->resident.load(std::memory_order_relaxed);
+    group->used += info->used.load(std::memory_order_relaxed);
+    group->peak_committed += info->peak_committed.load(std::memory_order_relaxed);
+    group->peak_resident += info->peak_resident.load(std::memory_order_relaxed);
+    group->peak_used += info->peak_used.load(std::memory_order_relaxed);
+    group->pushes += info->pushes.load(std::memory_order_relaxed);
+  }
+  pthread_mutex_unlock(&arena_registry.mutex);
+
+  for (u32 i = 1; i < result; ++i) {
+    Arena_Group group = groups[i];
+    u32 j = i;
+    for (; j > 0 && groups[j - 1].peak_resident < group.peak_resident; --j) {
+      groups[j] = groups[j - 1];
+    }
+    groups[j] = group;
+  }
+
+  return result;
+}
+
+// Resident bytes of every group as args of one zero length event, spall has no counters.
+static void arena_profile_counters() {
+#if PROFILE_ENABLE
+  Arena_Group groups[64];
+  u32 num_groups = arena_collect_groups(groups, ArrayLength(groups));
+
+  char args[2048];
+  u32 length = 0;
+  for (u32 i = 0; i < num_groups && length < sizeof(args); ++i) {
+    length += snprintf(args + length, sizeof(args) - length, "%s%s: %.1f MB", i ? ", " : "", groups[i].name,
+                       (f64)groups[i].resident / MiB(1));
+  }
+  ProfileValues("arenas", args, Min(length, (u32)sizeof(args) - 1));
+#endif
+}
+
+static void arena_memory_window() {
+  ProfileFuncBegin();
+
+  if (ImGui::Begin("Memory")) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    f64 peak_rss = (f64)usage.ru_maxrss / MiB(1);
+#else
+    f64 peak_rss = (f64)usage.ru_maxrss / KiB(1);
+#endif
+    ImGui::Text("process peak RSS: %.1f MB", peak_rss);
+
+    Arena_Group groups[64];
+    u32 num_groups = arena_collect_groups(groups, ArrayLength(groups));
+
+    ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
+    if (ImGui::BeginTable("arenas", 9, flags)) {
+      ImGui::TableSetupColumn("arena");
+      ImGui::TableSetupColumn("count");
+      ImGui::TableSetupColumn("used MB");
+      ImGui::TableSetupColumn("resident MB");
+      ImGui::TableSetupColumn("peak resident");
+      ImGui::TableSetupColumn("committed MB");
+      ImGui::TableSetupColumn("reserved MB");
+      ImGui::TableSetupColumn("blocks");
+      ImGui::TableSetupColumn("pushes");
+      ImGui::TableHeadersRow();
+
+      Arena_Group total = { .name = "total" };
+      for (u32 i = 0; i <= num_groups; ++i) {
+        Arena_Group *group = i < num_groups ? &groups[i] : &total;
+        if (i < num_groups) {
+          total.count += group->count;
+          total.num_blocks += group->num_blocks;
+          total.reserved += group->reserved;
+          total.committed += group->committed;
+          total.resident += group->resident;
+          total.used += group->used;
+          total.peak_resident += group->peak_resident;
+          total.pushes += group->pushes;
+        }
+
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn(); ImGui::Text("%s", group->name);
+        ImGui::TableNextColumn(); ImGui::Text("%u", group->count);
+        ImGui::TableNextColumn(); ImGui::Text("%.1f", (f64)group->used / MiB(1));
+        ImGui::TableNextColumn(); ImGui::Text("%.1f", (f64)group->resident / MiB(1));
+        ImGui::TableNextColumn(); ImGui::Text("%.1f", (f64)group->peak_resident / MiB(1));
+        ImGui::TableNextColumn(); ImGui::Text("%.1f", (f64)group->committed / MiB(1));
+        ImGui::TableNextColumn(); ImGui::Text("%.1f", (f64)group->reserved / MiB(1));
+        ImGui::TableNextColumn(); ImGui::Text("%u", group->num_blocks);
+        ImGui::TableNextColumn(); ImGui::Text("%llu", group->pushes);
+      }
+      ImGui::EndTable();
+    }
+
+    if (arena_registry.untracked) {
+      ImGui::Text("%u arenas not tracked, the registry is full", arena_registry.untracked);
+    }
+    ImGui::Text("freelist: %.1f MB reserved", (f64)arena_freelist.size / MiB(1));
+    ImGui::Text("blocks: %llu mapped (%llu huge), %llu reused, %llu unmapped",
+                arena_stats.fresh_maps.load(), arena_stats.huge_maps.load(), arena_stats.reuses.load(),
+                arena_stats.unmaps.load());
+    ImGui::Text("pages given back: %.1f MB", (f64)arena_stats.decommitted.load() / MiB(1));
+  }
+  ImGui::End();
+
+  ProfileEnd();
+}
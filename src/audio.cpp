@@ -0,0 +1,293 @@
+static bool audio_open_stream(Audio *audio) {
+  ProfileFuncBegin();
+
+  bool result = false;
+
+  if (avformat_open_input(&audio->fmt_ctx, audio->path, NULL, NULL) >= 0 &&
+      avformat_find_stream_info(audio->fmt_ctx, NULL) >= 0) {
+    const AVCodec *codec = NULL;
+    audio->stream_index = av_find_best_stream(audio->fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, &codec, 0);
+
+    if (audio->stream_index >= 0 && codec) {
+      AVStream *stream = audio->fmt_ctx->streams[audio->stream_index];
+      audio->time_base = stream->time_base;
+      audio->start_pts = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+
+      for (u32 i = 0; i < audio->fmt_ctx->nb_streams; ++i) {
+        if ((s32)i != audio->stream_index) {
+          audio->fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+        }
+      }
+
+      audio->codec_ctx = avcodec_alloc_context3(codec);
+      chk_err(avcodec_parameters_to_context(audio->codec_ctx, stream->codecpar));
+      chk_err(avcodec_open2(audio->codec_ctx, codec, NULL));
+
+      AVChannelLayout out_layout;
+      av_channel_layout_default(&out_layout, AUDIO_OUTPUT_CHANNELS);
+      chk_err(swr_alloc_set_opts2(&audio->swr_ctx,
+                                  &out_layout, AV_SAMPLE_FMT_FLT, AUDIO_OUTPUT_SAMPLE_RATE,
+                                  &audio->codec_ctx->ch_layout, audio->codec_ctx->sample_fmt,
+                                  audio->codec_ctx->sample_rate, 0, NULL));
+      chk_err(swr_init(audio->swr_ctx));
+      av_channel_layout_uninit(&out_layout);
+
+      audio->packet = av_packet_alloc();
+      audio->frame = av_frame_alloc();
+
+      printf("audio: %d Hz -> %d Hz\n", audio->codec_ctx->sample_rate, AUDIO_OUTPUT_SAMPLE_RATE);
+      result = true;
+    }
+  }
+
+  if (!result) {
+    avformat_close_input(&audio->fmt_ctx);
+  }
+
+  ProfileEnd();
+
+  return result;
+}
+
+static void audio_close_stream(Audio *audio) {
+  ProfileFuncBegin();
+
+  swr_free(&audio->swr_ctx);
+  av_frame_free(&audio->frame);
+  av_packet_free(&audio->packet);
+  avcodec_free_context(&audio->codec_ctx);
+  avformat_close_input(&audio->fmt_ctx);
+
+  ProfileEnd();
+}
+
+// Decodes the next audio frame into audio->frame, false at end of stream.
+static bool audio_decode_next(Audio *audio) {
+  ProfileFuncBegin();
+
+  av_frame_unref(audio->frame);
+
+  bool result = false;
+  for (;;) {
+    s32 response = avcodec_receive_frame(audio->codec_ctx, audio->frame);
+    if (response >= 0) {
+      result = true;
+      break;
+    } else if (response == AVERROR_EOF) {
+      break;
+    } else if (response != AVERROR(EAGAIN)) {
+      chk_err(response);
+      break;
+    }
+
+    if (av_read_frame(audio->fmt_ctx, audio->packet) < 0) {
+      avcodec_send_packet(audio->codec_ctx, NULL);
+      continue;
+    }
+
+    if (audio->packet->stream_index == audio->stream_index) {
+      chk_err(avcodec_send_packet(audio->codec_ctx, audio->packet));
+    }
+    av_packet_unref(audio->packet);
+  }
+
+  ProfileEnd();
+
+  return result;
+}
+
+static void audio_handle_seek(Audio *audio, u32 serial, f64 sec) {
+  ProfileFuncBegin();
+
+  s64 pts = audio->start_pts + sec_to_pts(audio->time_base, sec);
+  avformat_seek_file(audio->fmt_ctx, audio->stream_index, INT64_MIN, pts, pts, AVSEEK_FLAG_BACKWARD);
+  avcodec_flush_buffers(audio->codec_ctx);
+
+  // drop whatever the resampler still buffers
+  swr_init(audio->swr_ctx);
+
+  audio->end_of_stream = false;
+  audio->is_drained = false;
+  audio->drop_until = INT64_MIN;
+  audio->decode_seek_time = sec;
+
+  // everything written from here on belongs to the new position
+  audio->seek_ring_pos.store(audio->ring.write_pos.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  audio->seek_clock_base.store(sec, std::memory_order_relaxed);
+  audio->seek_serial.store(serial, std::memory_order_release);
+
+  ProfileEnd();
+}
+
+// Resamples audio->frame and writes it to the ring, trimming samples that
+// come before the last seek target.
+static void audio_write_frame(Audio *audio) {
+  ProfileFuncBegin();
+
+  AVFrame *frame = audio->frame;
+  s32 frames = swr_convert(audio->swr_ctx, (u8 **)&audio->chunk, AUDIO_MAX_CHUNK_FRAMES,
+                           (const u8 **)frame->extended_data, frame->nb_samples);
+
+  f32 *samples = audio->chunk;
+  if (frames > 0 && audio->drop_until == INT64_MIN && frame->pts != AV_NOPTS_VALUE) {
+    // the first frame after a seek starts before the target, find how far
+    f64 frame_sec = pts_to_sec(audio->time_base, frame->pts - audio->start_pts);
+    audio->drop_until = (s64)((audio->decode_seek_time - frame_sec) * AUDIO_OUTPUT_SAMPLE_RATE);
+  }
+
+  if (frames > 0 && audio->drop_until > 0) {
+    s32 drop = (s32)Min((s64)frames, audio->drop_until);
+    samples += drop * AUDIO_OUTPUT_CHANNELS;
+    frames -= drop;
+    audio->drop_until -= drop;
+  }
+
+  if (frames > 0) {
+    audio_ring_write(&audio->ring, samples, frames);
+  }
+
+  ProfileEnd();
+}
+
+static void *audio_thread(void *ptr) {
+  Audio *audio = (Audio *)ptr;
+
+  profile_thread_init();
+
+  u32 handled_serial = 0;
+
+  while (audio->is_running) {
+    pthread_mutex_lock(&audio->mutex);
+    u32 serial = audio->seek_requested_serial;
+    f64 seek_time = audio->seek_time;
+    pthread_mutex_unlock(&audio->mutex);
+
+    if (serial != handled_serial) {
+      audio_handle_seek(audio, serial, seek_time);
+      handled_serial = serial;
+      continue;
+    }
+
+    // the decoder writes up to one chunk at a time, wait until it fits
+    u64 space = AUDIO_RING_FRAMES - audio_ring_count(&audio->ring);
+    if (audio->end_of_stream || space < AUDIO_MAX_CHUNK_FRAMES) {
+      if (audio->end_of_stream && audio_ring_count(&audio->ring) == 0) {
+        audio->is_drained = true;
+      }
+      usleep(AUDIO_SINK_PERIOD_MS * 1000 / 2);
+      continue;
+    }
+
+    if (audio_decode_next(audio)) {
+      audio_write_frame(audio);
+    } else {
+      audio->end_of_stream = true;
+    }
+  }
+
+  profile_thread_shutdown();
+
+  scratch_release_thread();
+
+  return NULL;
+}
+
+static void audio_init(Audio *audio, const char *path, Audio_Sink_Type sink) {
+  ProfileFuncBegin();
+
+  snprintf(audio->path, MAX_PATH_LENGTH, "%s", path);
+  audio->has_stream = audio_open_stream(audio);
+
+  if (audio->has_stream) {
+    audio->mutex = PTHREAD_MUTEX_INITIALIZER;
+    audio->arena = arena_alloc((Arena_Params){
+      .name = "audio",
+      .reserve_size = MiB(4),
+      .commit_size = MiB(4),
+    });
+    audio->ring.samples = push_array(audio->arena, f32, AUDIO_RING_FRAMES * AUDIO_OUTPUT_CHANNELS);
+    audio->chunk = push_array(audio->arena, f32, AUDIO_MAX_CHUNK_FRAMES * AUDIO_OUTPUT_CHANNELS);
+    audio->drop_until = 0;
+
+    audio->is_running = true;
+    pthread_create(&audio->thread, NULL, audio_thread, (void *)audio);
+
+    audio_output_start(audio, sink);
+  } else {
+    printf("audio: no audio stream in '%s'\n", path);
+  }
+
+  ProfileEnd();
+}
+
+static void audio_shutdown(Audio *audio) {
+  ProfileFuncBegin();
+
+  if (audio->has_stream) {
+    audio_output_stop(audio);
+
+    audio->is_running = false;
+    pthread_join(audio->thread, NULL);
+
+    audio_close_stream(audio);
+    arena_release(audio->arena);
+    audio->has_stream = false;
+  }
+
+  ProfileEnd();
+}
+
+static void audio_seek(Audio *audio, f64 sec) {
+  ProfileFuncBegin();
+
+  pthread_mutex_lock(&audio->mutex);
+  audio->seek_requested_serial++;
+  audio->seek_time = sec;
+  pthread_mutex_unlock(&audio->mutex);
+
+  ProfileEnd();
+}
+
+static void audio_set_playing(Audio *audio, bool is_playing) {
+  audio->output.is_playing = is_playing;
+}
+
+// Source time of the sample being played right now. While a seek is still in
+// flight this is the seek target.
+static f64 audio_clock(Audio *audio) {
+  Audio_Output *output = &audio->output;
+
+  pthread_mutex_lock(&audio->mutex);
+  u32 requested = audio->seek_requested_serial;
+  f64 seek_time = audio->seek_time;
+  pthread_mutex_unlock(&audio->mutex);
+
+  f64 result = seek_time;
+  if (output->seen_seek_serial.load(std::memory_order_acquire) == requested) {
+    result = output->clock_base.load(std::memory_order_relaxed) +
+             output->frames_played.load(std::memory_order_relaxed) / (f64)AUDIO_OUTPUT_SAMPLE_RATE;
+  }
+
+  return result;
+}
+
+static void audio_debug_ui(Audio *audio) {
+  ProfileFuncBegin();
+
+  if (ImGui::Begin("Audio")) {
+    if (audio->has_stream) {
+      Audio_Output *output = &audio->output;
+      f64 buffered_ms = audio_ring_count(&audio->ring) * 1000.0 / AUDIO_OUTPUT_SAMPLE_RATE;
+
+      ImGui::Text("sink: %s", audio_sink_names[output->sink]);
+      ImGui::Text("clock: %.3fs", audio_clock(audio));
+      ImGui::Text("buffered: %.1f ms", buffered_ms);
+      ImGui::Text("underruns: %llu", output->underruns.load());
+    } else {
+      ImGui::Text("no audio stream");
+    }
+  }
+  ImGui::End();
+
+  ProfileEnd();
+}
@@ -0,0 +1,263 @@
+#if __APPLE__
+#include <AudioToolbox/AudioToolbox.h>
+#endif
+
+static const char *audio_sink_names[NUM_AUDIO_SINKS] = {
+  "null",
+  "wav",
+  "device",
+};
+
+static inline u64 audio_ring_count(Audio_Ring *ring) {
+  return ring->write_pos.load(std::memory_order_acquire) - ring->read_pos.load(std::memory_order_acquire);
+}
+
+// Producer side. Returns the number of frames written.
+static u64 audio_ring_write(Audio_Ring *ring, f32 *frames, u64 count) {
+  u64 write_pos = ring->write_pos.load(std::memory_order_relaxed);
+  u64 read_pos = ring->read_pos.load(std::memory_order_acquire);
+  count = Min(count, AUDIO_RING_FRAMES - (write_pos - read_pos));
+
+  u64 start = write_pos & (AUDIO_RING_FRAMES - 1);
+  u64 first = Min(count, AUDIO_RING_FRAMES - start);
+  memcpy(ring->samples + start * AUDIO_OUTPUT_CHANNELS, frames,
+         first * AUDIO_OUTPUT_CHANNELS * sizeof(f32));
+  memcpy(ring->samples, frames + first * AUDIO_OUTPUT_CHANNELS,
+         (count - first) * AUDIO_OUTPUT_CHANNELS * sizeof(f32));
+
+  ring->write_pos.store(write_pos + count, std::memory_order_release);
+  return count;
+}
+
+// Consumer side. Returns the number of frames read.
+static u64 audio_ring_read(Audio_Ring *ring, f32 *frames, u64 count) {
+  u64 read_pos = ring->read_pos.load(std::memory_order_relaxed);
+  u64 write_pos = ring->write_pos.load(std::memory_order_acquire);
+  count = Min(count, write_pos - read_pos);
+
+  u64 start = read_pos & (AUDIO_RING_FRAMES - 1);
+  u64 first = Min(count, AUDIO_RING_FRAMES - start);
+  memcpy(frames, ring->samples + start * AUDIO_OUTPUT_CHANNELS,
+         first * AUDIO_OUTPUT_CHANNELS * sizeof(f32));
+  memcpy(frames + first * AUDIO_OUTPUT_CHANNELS, ring->samples,
+         (count - first) * AUDIO_OUTPUT_CHANNELS * sizeof(f32));
+
+  ring->read_pos.store(read_pos + count, std::memory_order_release);
+  return count;
+}
+
+// The output callback, called by every sink from its own thread. Never blocks.
+static void audio_output_fill(Audio *audio, f32 *out, u32 frames) {
+  Audio_Output *output = &audio->output;
+  Audio_Ring *ring = &audio->ring;
+
+  // a seek finished, skip the stale samples and restart the clock
+  u32 serial = audio->seek_serial.load(std::memory_order_acquire);
+  if (serial != output->seen_seek_serial.load(std::memory_order_relaxed)) {
+    u64 seek_pos = audio->seek_ring_pos.load(std::memory_order_relaxed);
+    if (ring->read_pos.load(std::memory_order_relaxed) < seek_pos) {
+      ring->read_pos.store(seek_pos, std::memory_order_release);
+    }
+    output->frames_played.store(0, std::memory_order_relaxed);
+    output->clock_base.store(audio->seek_clock_base.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    output->seen_seek_serial.store(serial, std::memory_order_release);
+  }
+
+  u64 read = 0;
+  if (output->is_playing.load(std::memory_order_relaxed)) {
+    read = audio_ring_read(ring, out, frames);
+
+    if (read < frames && audio->is_drained.load(std::memory_order_relaxed)) {
+      // past the end of the audio, keep the clock running over the silence
+      output->frames_played.fetch_add(frames, std::memory_order_relaxed);
+    } else {
+      output->frames_played.fetch_add(read, std::memory_order_relaxed);
+      if (read < frames) output->underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  memset(out + read * AUDIO_OUTPUT_CHANNELS, 0, (frames - read) * AUDIO_OUTPUT_CHANNELS * sizeof(f32));
+}
+
+static void wav_write_header(FILE *file, u64 frames) {
+  u32 bytes_per_frame = AUDIO_OUTPUT_CHANNELS * sizeof(f32);
+  u32 data_size = (u32)(frames * bytes_per_frame);
+
+  struct {
+    char riff[4]; u32 riff_size; char wave[4];
+    char fmt[4]; u32 fmt_size; u16 format; u16 channels; u32 sample_rate;
+    u32 byte_rate; u16 block_align; u16 bits_per_sample;
+    char data[4]; u32 data_size;
+  } header = {
+    {'R','I','F','F'}, 36 + data_size, {'W','A','V','E'},
+    {'f','m','t',' '}, 16, 3 /* IEEE float */, AUDIO_OUTPUT_CHANNELS, AUDIO_OUTPUT_SAMPLE_RATE,
+    AUDIO_OUTPUT_SAMPLE_RATE * bytes_per_frame, (u16)bytes_per_frame, 32,
+    {'d','a','t','a'}, data_size,
+  };
+
+  fseek(file, 0, SEEK_SET);
+  fwrite(&header, sizeof(header), 1, file);
+}
+
+// Drives the null and wav sinks, pulling samples at the output rate.
+static void *audio_sink_thread(void *ptr) {
+  Audio *audio = (Audio *)ptr;
+  Audio_Output *output = &audio->output;
+
+  profile_thread_init();
+
+  f32 buffer[AUDIO_SINK_PERIOD_MS * AUDIO_OUTPUT_SAMPLE_RATE / 1000 * 4 * AUDIO_OUTPUT_CHANNELS];
+  u32 max_frames = ArrayLength(buffer) / AUDIO_OUTPUT_CHANNELS;
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  u64 frames_consumed = 0;
+
+  while (output->is_running) {
+    usleep(AUDIO_SINK_PERIOD_MS * 1000);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    f64 elapsed = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+    u64 frames_due = (u64)(elapsed * AUDIO_OUTPUT_SAMPLE_RATE);
+
+    while (frames_consumed < frames_due) {
+      u32 frames = (u32)Min(frames_due - frames_consumed, (u64)max_frames);
+      audio_output_fill(audio, buffer, frames);
+      frames_consumed += frames;
+
+      if (output->wav_file && output->is_playing) {
+        fwrite(buffer, sizeof(f32) * AUDIO_OUTPUT_CHANNELS, frames, output->wav_file);
+        output->wav_frames += frames;
+      }
+    }
+  }
+
+  profile_thread_shutdown();
+
+  scratch_release_thread();
+
+  return NULL;
+}
+
+#if __APPLE__
+static void audio_device_callback(void *user_data, AudioQueueRef queue, AudioQueueBufferRef buffer) {
+  Audio *audio = (Audio *)user_data;
+
+  u32 frames = buffer->mAudioDataBytesCapacity / (AUDIO_OUTPUT_CHANNELS * sizeof(f32));
+  audio_output_fill(audio, (f32 *)buffer->mAudioData, frames);
+  buffer->mAudioDataByteSize = frames * AUDIO_OUTPUT_CHANNELS * sizeof(f32);
+
+  AudioQueueEnqueueBuffer(queue, buffer, 0, NULL);
+}
+
+static bool audio_device_start(Audio *audio) {
+  AudioStreamBasicDescription format = {0};
+  format.mSampleRate = AUDIO_OUTPUT_SAMPLE_RATE;
+  format.mFormatID = kAudioFormatLinearPCM;
+  format.mFormatFlags = kLinearPCMFormatFlagIsFloat | kLinearPCMFormatFlagIsPacked;
+  format.mBytesPerPacket = AUDIO_OUTPUT_CHANNELS * sizeof(f32);
+  format.mFramesPerPacket = 1;
+  format.mBytesPerFrame = AUDIO_OUTPUT_CHANNELS * sizeof(f32);
+  format.mChannelsPerFrame = AUDIO_OUTPUT_CHANNELS;
+  format.mBitsPerChannel = 32;
+
+  AudioQueueRef queue = NULL;
+  if (AudioQueueNewOutput(&format, audio_device_callback, audio, NULL, NULL, 0, &queue) != noErr) {
+    fprintf(stderr, "Could not open audio device\n");
+    return false;
+  }
+
+  // three buffers of one sink period each
+  u32 buffer_bytes = AUDIO_SINK_PERIOD_MS * AUDIO_OUTPUT_SAMPLE_RATE / 1000 * AUDIO_OUTPUT_CHANNELS * sizeof(f32);
+  for (u32 i = 0; i < 3; ++i) {
+    AudioQueueBufferRef buffer;
+    AudioQueueAllocateBuffer(queue, buffer_bytes, &buffer);
+    audio_device_callback(audio, queue, buffer);
+  }
+
+  AudioQueueStart(queue, NULL);
+  audio->output.device = queue;
+  return true;
+}
+
+static void audio_device_stop(Audio *audio) {
+  AudioQueueRef queue = (AudioQueueRef)audio->output.device;
+  AudioQueueStop(queue, true);
+  AudioQueueDispose(queue, true);
+  audio->output.device = NULL;
+}
+#else
+static bool audio_device_start(Audio *audio) {
+  fprintf(stderr, "No audio device sink on this platform\n");
+  return false;
+}
+
+static void audio_device_stop(Audio *audio) {
+}
+#endif
+
+static void audio_output_start(Audio *audio, Audio_Sink_Type sink) {
+  ProfileFuncBegin();
+
+  Audio_Output *output = &audio->output;
+  output->is_running = true;
+
+  if (sink == AUDIO_SINK__DEVICE && !audio_device_start(audio)) {
+    sink = AUDIO_SINK__NULL;
+  }
+  output->sink = sink;
+
+  if (sink == AUDIO_SINK__WAV) {
+    output->wav_file = fopen("audio_out.wav", "wb");
+    output->wav_frames = 0;
+    if (output->wav_file) {
+      wav_write_header(output->wav_file, 0);
+    } else {
+      fprintf(stderr, "Could not open audio_out.wav\n");
+    }
+  }
+
+  if (sink != AUDIO_SINK__DEVICE) {
+    pthread_create(&output->thread, NULL, audio_sink_thread, (void *)audio);
+  }
+
+  ProfileEnd();
+}
+
+static void audio_output_stop(Audio *audio) {
+  ProfileFuncBegin();
+
+  Audio_Output *output = &audio->output;
+  output->is_running = false;
+
+  if (output->sink == AUDIO_SINK__DEVICE) {
+    audio_device_stop(audio);
+  } else {
+    pthread_join(output->thread, NULL);
+  }
+
+  if (output->wav_file) {
+    wav_write_header(output->wav_file, output->wav_frames);
+    fclose(output->wav_file);
+    output->wav_file = NULL;
+  }
+
+  ProfileEnd();
+}
+
+// GOLDEN_GROUSE_AUDIO_SINK=null|wav|device, defaults to the device
+static Audio_Sink_Type audio_sink_from_env() {
+  Audio_Sink_Type result = AUDIO_SINK__DEVICE;
+
+  const char *name = getenv("GOLDEN_GROUSE_AUDIO_SINK");
+  if (name) {
+    for (u32 i = 0; i < NUM_AUDIO_SINKS; ++i) {
+      if (strcmp(name, audio_sink_names[i]) == 0) {
+        result = (Audio_Sink_Type)i;
+      }
+    }
+  }
+
+  return result;
+}
@@ -0,0 +1,313 @@
+static void captions_init(Captions *captions, const char *font_path) {
+  ProfileFuncBegin();
+
+  *captions = {0};
+  captions->is_enabled = true;
+  captions->arena = arena_alloc((Arena_Params){
+    .name = "captions",
+    .reserve_size = MiB(4),
+    .commit_size = MiB(1),
+  });
+  captions->blocks = push_array(captions->arena, Caption_Block, CAPTION_MAX_BLOCKS);
+  captions->words = push_array(captions->arena, Caption_Word, CAPTION_MAX_WORDS);
+  captions->text = push_array(captions->arena, char, CAPTION_TEXT_SIZE);
+
+  captions->style = (Caption_Style){
+    .size = 0.045f,
+    .y = 0.72f,
+    .max_width = 0.85f,
+    .color = rgba8(1.0f, 1.0f, 1.0f, 1.0f),
+    .upcoming_color = rgba8(1.0f, 1.0f, 1.0f, 0.45f),
+    .highlight_color = rgba8(1.0f, 0.85f, 0.2f, 1.0f),
+    .outline_color = { 0.0f, 0.0f, 0.0f, 0.9f },
+    .outline_width = 0.2f,
+    .pop = 0.15f,
+  };
+
+  text_renderer_init(&captions->text_renderer, font_path);
+
+  ProfileEnd();
+}
+
+static void captions_shutdown(Captions *captions) {
+  ProfileFuncBegin();
+
+  text_renderer_shutdown(&captions->text_renderer);
+  arena_release(captions->arena);
+  *captions = {0};
+
+  ProfileEnd();
+}
+
+static void captions_clear(Captions *captions) {
+  captions->num_blocks = 0;
+  captions->num_words = 0;
+  captions->text_size = 0;
+}
+
+static inline bool is_caption_space(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Splits text into words and spreads start..end over them by length, roughly
+// how long each takes to say. Appends to the last block unless is_new_block.
+static bool captions_add_words(Captions *captions, f64 start, f64 end, const char *text, bool is_new_block) {
+  u32 length = (u32)strlen(text);
+  u32 total_chars = 0;
+  u32 num_words = 0;
+  for (u32 i = 0; i < length; ++i) {
+    if (!is_caption_space(text[i])) {
+      total_chars++;
+      if (i == 0 || is_caption_space(text[i - 1])) num_words++;
+    }
+  }
+
+  if (num_words == 0) return true;
+  if (captions->num_words + num_words > CAPTION_MAX_WORDS ||
+      captions->text_size + length > CAPTION_TEXT_SIZE ||
+      (is_new_block && captions->num_blocks == CAPTION_MAX_BLOCKS)) {
+    fprintf(stderr, "Captions: too many captions\n");
+    return false;
+  }
+
+  if (is_new_block || captions->num_blocks == 0) {
+    Caption_Block *block = &captions->blocks[captions->num_blocks++];
+    block->start = start;
+    block->end = end;
+    block->first_word = captions->num_words;
+    block->num_words = 0;
+  }
+  Caption_Block *block = &captions->blocks[captions->num_blocks - 1];
+
+  f64 time = start;
+  f64 per_char = (end - start) / total_chars;
+  for (u32 i = 0; i < length;) {
+    while (i < length && is_caption_space(text[i])) ++i;
+    u32 word_start = i;
+    while (i < length && !is_caption_space(text[i])) ++i;
+    if (i == word_start) break;
+
+    Caption_Word *word = &captions->words[captions->num_words++];
+    word->text_offset = captions->text_size;
+    word->text_length = i - word_start;
+    word->start = time;
+    time += per_char * word->text_length;
+    word->end = time;
+
+    memcpy(captions->text + captions->text_size, text + word_start, word->text_length);
+    captions->text_size += word->text_length;
+    block->num_words++;
+  }
+
+  block->start = Min(block->start, start);
+  block->end = Max(block->end, end);
+
+  return true;
+}
+
+static s32 caption_block_compare(const void *a, const void *b) {
+  f64 start_a = ((Caption_Block *)a)->start;
+  f64 start_b = ((Caption_Block *)b)->start;
+  return (start_a > start_b) - (start_a < start_b);
+}
+
+static void captions_sort(Captions *captions) {
+  qsort(captions->blocks, captions->num_blocks, sizeof(Caption_Block), caption_block_compare);
+}
+
+// Loads a captions file, replacing the current captions. Each line is
+// "<start> <end> <text>" in timeline seconds, the line's words share its time.
+// A line per word gives per-word timing. Blank lines end a block, lines
+// starting with # are skipped.
+static bool captions_load(Captions *captions, const char *path) {
+  ProfileFuncBegin();
+
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    ProfileEnd();
+    return false;
+  }
+
+  captions_clear(captions);
+
+  bool result = true;
+  bool is_new_block = true;
+  char line[1024];
+  for (u32 line_number = 1; fgets(line, sizeof(line), file); ++line_number) {
+    char *text = line;
+    while (is_caption_space(*text)) ++text;
+
+    if (*text == 0) {
+      is_new_block = true;
+      continue;
+    }
+    if (*text == '#') continue;
+
+    f64 start, end;
+    s32 consumed = 0;
+    if (sscanf(text, "%lf %lf %n", &start, &end, &consumed) != 2 || consumed == 0 || end < start) {
+      fprintf(stderr, "Captions: %s:%u: expected '<start> <end> <text>'\n", path, line_number);
+      result = false;
+      break;
+    }
+
+    if (!captions_add_words(captions, start, end, text + consumed, is_new_block)) {
+      result = false;
+      break;
+    }
+    is_new_block = false;
+  }
+  fclose(file);
+
+  captions_sort(captions);
+  printf("captions: %u blocks, %u words from '%s'\n", captions->num_blocks, captions->num_words, path);
+
+  ProfileEnd();
+
+  return result;
+}
+
+static Caption_Block *captions_block_at(Captions *captions, f64 t) {
+  // the last block starting at or before t
+  u32 lo = 0, hi = captions->num_blocks;
+  while (lo < hi) {
+    u32 mid = (lo + hi) / 2;
+    if (captions->blocks[mid].start <= t) lo = mid + 1;
+    else hi = mid;
+  }
+
+  Caption_Block *result = NULL;
+  if (lo > 0 && t < captions->blocks[lo - 1].end) {
+    result = &captions->blocks[lo - 1];
+  }
+  return result;
+}
+
+// Draws the block visible at t over the target, every glyph in one batch.
+// Lines wrap at the style's max width and are centered. Words light up as
+// they are spoken, with a small pop of the spoken word.
+static void captions_draw(Captions *captions, Render_Target *target, f64 t) {
+  ProfileFuncBegin();
+
+  Text_Renderer *tr = &captions->text_renderer;
+  Caption_Block *block = captions->is_enabled && tr->is_loaded ? captions_block_at(captions, t) : NULL;
+
+  if (block) {
+    Caption_Style *style = &captions->style;
+    Glyph_Atlas *atlas = &tr->atlas;
+
+    f32 pixel_height = style->size * target->height;
+    f32 scale = pixel_height / GLYPH_PIXEL_HEIGHT;
+    f32 line_height = (atlas->ascent - atlas->descent + atlas->line_gap) * scale;
+    f32 space = text_measure(tr, " ", 1, pixel_height);
+    f32 max_width = style->max_width * target->width;
+
+    // break into lines first, widths are needed to center them
+    u32 line_ends[64];
+    f32 line_widths[64];
+    u32 num_lines = 0;
+    f32 width = 0.0f;
+    for (u32 i = 0; i < block->num_words; ++i) {
+      Caption_Word *word = &captions->words[block->first_word + i];
+      f32 word_width = text_measure(tr, captions->text + word->text_offset, word->text_length, pixel_height);
+
+      if (width > 0.0f && width + space + word_width > max_width && num_lines < ArrayLength(line_ends) - 1) {
+        line_ends[num_lines] = i;
+        line_widths[num_lines] = width;
+        num_lines++;
+        width = 0.0f;
+      }
+      width += (width > 0.0f ? space : 0.0f) + word_width;
+    }
+    line_ends[num_lines] = block->num_words;
+    line_widths[num_lines] = width;
+    num_lines++;
+
+    f32 baseline = style->y * target->height - num_lines * line_height * 0.5f + atlas->ascent * scale;
+
+    text_begin(tr);
+    u32 word_index = 0;
+    for (u32 line = 0; line < num_lines; ++line) {
+      f32 x = (target->width - line_widths[line]) * 0.5f;
+
+      for (; word_index < line_ends[line]; ++word_index) {
+        Caption_Word *word = &captions->words[block->first_word + word_index];
+        const char *text = captions->text + word->text_offset;
+        f32 word_width = text_measure(tr, text, word->text_length, pixel_height);
+
+        u32 color = style->color;
+        f32 word_height = pixel_height;
+        if (t < word->start) {
+          color = style->upcoming_color;
+        } else if (t < word->end) {
+          color = style->highlight_color;
+          // pops in over the first tenth of a second and settles
+          f32 progress = (f32)Min((t - word->start) / 0.1, 1.0);
+          word_height *= 1.0f + style->pop * (1.0f - progress);
+        }
+
+        // grows around its center and baseline
+        f32 grown = word_width * (word_height / pixel_height) - word_width;
+        text_push(tr, target, text, word->text_length, x - grown * 0.5f, baseline, word_height, color);
+
+        x += word_width + space;
+      }
+
+      baseline += line_height;
+    }
+
+    text_flush(tr, target, style->outline_color, style->outline_width);
+  }
+
+  ProfileEnd();
+}
+
+static void captions_window(Captions *captions, f64 time) {
+  ProfileFuncBegin();
+
+  if (ImGui::Begin("Captions")) {
+    ImGui::Checkbox("show captions", &captions->is_enabled);
+
+    static char path[MAX_PATH_LENGTH] = "./videos/jackal.captions.txt";
+    ImGui::InputText("file", path, sizeof(path));
+    ImGui::SameLine();
+    if (ImGui::Button("Load")) {
+      captions_load(captions, path);
+    }
+
+    // quick captions without a file, the words are timed by length
+    static char text[256];
+    static f32 duration = 2.0f;
+    ImGui::InputText("text", text, sizeof(text));
+    ImGui::DragFloat("duration", &duration, 0.05f, 0.1f, 30.0f, "%.2fs");
+    if (ImGui::Button("Add at playhead")) {
+      captions_add_words(captions, time, time + duration, text, true);
+      captions_sort(captions);
+      text[0] = 0;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Clear")) {
+      captions_clear(captions);
+    }
+
+    Caption_Style *style = &captions->style;
+    ImGui::SliderFloat("size", &style->size, 0.01f, 0.2f);
+    ImGui::SliderFloat("position", &style->y, 0.0f, 1.0f);
+    ImGui::SliderFloat("max width", &style->max_width, 0.2f, 1.0f);
+    ImGui::SliderFloat("outline", &style->outline_width, 0.0f, 0.45f);
+    ImGui::ColorEdit4("outline color", style->outline_color);
+    ImGui::SliderFloat("pop", &style->pop, 0.0f, 0.5f);
+
+    Text_Renderer *tr = &captions->text_renderer;
+    ImGui::Text("blocks: %u, words: %u", captions->num_blocks, captions->num_words);
+    if (tr->is_loaded) {
+      ImGui::Text("glyphs: %u drawn in %u draw calls, %u in the atlas%s", tr->stats.glyphs, tr->stats.draw_calls,
+                  tr->atlas.num_glyphs, tr->atlas.is_full ? " (full)" : "");
+    } else {
+      ImGui::Text("no font loaded");
+    }
+  }
+  ImGui::End();
+
+  ProfileEnd();
+}
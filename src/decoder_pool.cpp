@@ -0,0 +1,281 @@
+static inline bool decoder_pool_entry_is_open(Decoder_Pool_Entry *entry) {
+  u32 state = entry->state.load(std::memory_order_relaxed);
+  return state == DECODER_POOL_STATE__OPENING || state == DECODER_POOL_STATE__READY;
+}
+
+static void decoder_pool_open_entry(Decoder_Pool_Entry *entry) {
+  ProfileFuncBegin();
+
+  // the entry may be reused after a failed open
+  memset(&entry->video, 0, sizeof(Video));
+
+  u32 state = DECODER_POOL_STATE__FAILED;
+  if (video_open(&entry->video, entry->path, VIDEO_OPEN_FLAG__NONE)) {
+    video_decoder_init(&entry->decoder, &entry->video);
+    video_decoder_seek(&entry->decoder, entry->start_sec);
+    entry->preroll_sec = entry->start_sec;
+    entry->bytes = yuv_frame_bytes(entry->video.width, entry->video.height, entry->video.layout) *
+                   VIDEO_DECODER_RING_SIZE;
+    state = DECODER_POOL_STATE__READY;
+  }
+  entry->state.store(state, std::memory_order_release);
+
+  ProfileEnd();
+}
+
+static void decoder_pool_close_entry(Decoder_Pool_Entry *entry) {
+  ProfileFuncBegin();
+
+  video_decoder_shutdown(&entry->decoder);
+  video_close(&entry->video);
+  memset(&entry->video, 0, sizeof(Video));
+  entry->decoder = {0};
+  entry->bytes = 0;
+  entry->state.store(DECODER_POOL_STATE__FREE, std::memory_order_release);
+
+  ProfileEnd();
+}
+
+static void *decoder_pool_thread(void *ptr) {
+  Decoder_Pool *pool = (Decoder_Pool *)ptr;
+
+  profile_thread_init();
+
+  pthread_mutex_lock(&pool->mutex);
+  while (pool->is_running) {
+    Decoder_Pool_Entry *work = NULL;
+    for (u32 i = 0; i < DECODER_POOL_MAX_ENTRIES && work == NULL; ++i) {
+      u32 state = pool->entries[i].state.load(std::memory_order_acquire);
+      if (state == DECODER_POOL_STATE__OPENING || state == DECODER_POOL_STATE__CLOSING) {
+        work = &pool->entries[i];
+      }
+    }
+
+    if (work == NULL) {
+      pthread_cond_wait(&pool->cond, &pool->mutex);
+      continue;
+    }
+
+    // the UI thread doesn't touch an entry in either state, no lock needed
+    pthread_mutex_unlock(&pool->mutex);
+    if (work->state.load(std::memory_order_acquire) == DECODER_POOL_STATE__OPENING) {
+      decoder_pool_open_entry(work);
+    } else {
+      decoder_pool_close_entry(work);
+    }
+    pthread_mutex_lock(&pool->mutex);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  profile_thread_shutdown();
+
+  scratch_release_thread();
+
+  return NULL;
+}
+
+static void decoder_pool_init(Decoder_Pool *pool, s32 max_open, u64 budget) {
+  ProfileFuncBegin();
+
+  pool->mutex = PTHREAD_MUTEX_INITIALIZER;
+  pool->cond = PTHREAD_COND_INITIALIZER;
+  pool->is_running = true;
+  pool->max_open = max_open;
+  pool->budget = budget;
+
+  pthread_create(&pool->thread, NULL, decoder_pool_thread, (void *)pool);
+
+  ProfileEnd();
+}
+
+static void decoder_pool_shutdown(Decoder_Pool *pool) {
+  ProfileFuncBegin();
+
+  pthread_mutex_lock(&pool->mutex);
+  pool->is_running = false;
+  pthread_cond_signal(&pool->cond);
+  pthread_mutex_unlock(&pool->mutex);
+
+  pthread_join(pool->thread, NULL);
+
+  // whatever the thread didn't get to
+  for (u32 i = 0; i < DECODER_POOL_MAX_ENTRIES; ++i) {
+    Decoder_Pool_Entry *entry = &pool->entries[i];
+    u32 state = entry->state.load(std::memory_order_acquire);
+    if (state == DECODER_POOL_STATE__READY || state == DECODER_POOL_STATE__CLOSING) {
+      decoder_pool_close_entry(entry);
+    }
+  }
+
+  ProfileEnd();
+}
+
+// Call once per frame, entries requested during the current frame are never evicted.
+static void decoder_pool_begin_frame(Decoder_Pool *pool) {
+  pool->frame++;
+}
+
+static void decoder_pool_set_state(Decoder_Pool *pool, Decoder_Pool_Entry *entry, u32 state) {
+  pthread_mutex_lock(&pool->mutex);
+  entry->state.store(state, std::memory_order_release);
+  pthread_cond_signal(&pool->cond);
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+// Closes idle entries, least recently used first, until new_entries more fit
+// under max_open and the open entries fit in the budget.
+static void decoder_pool_evict(Decoder_Pool *pool, s32 new_entries) {
+  ProfileFuncBegin();
+
+  for (;;) {
+    s32 num_open = 0;
+    u64 bytes_used = 0;
+    Decoder_Pool_Entry *victim = NULL;
+
+    for (u32 i = 0; i < DECODER_POOL_MAX_ENTRIES; ++i) {
+      Decoder_Pool_Entry *entry = &pool->entries[i];
+      if (!decoder_pool_entry_is_open(entry)) continue;
+
+      num_open++;
+      bytes_used += entry->bytes;
+
+      // entries still opening can't be closed yet
+      bool is_idle = entry->last_used != pool->frame &&
+                     entry->state.load(std::memory_order_acquire) == DECODER_POOL_STATE__READY;
+      if (is_idle && (victim == NULL || entry->last_used < victim->last_used)) {
+        victim = entry;
+      }
+    }
+
+    bool over_budget = num_open + new_entries > pool->max_open || bytes_used > pool->budget;
+    if (!over_budget || victim == NULL) break;
+
+    decoder_pool_set_state(pool, victim, DECODER_POOL_STATE__CLOSING);
+    pool->evictions++;
+  }
+
+  ProfileEnd();
+}
+
+// Returns the clip's entry if it is open or opening, without opening it.
+static Decoder_Pool_Entry *decoder_pool_find(Decoder_Pool *pool, u32 clip_id) {
+  Decoder_Pool_Entry *result = NULL;
+  for (u32 i = 0; i < DECODER_POOL_MAX_ENTRIES; ++i) {
+    Decoder_Pool_Entry *entry = &pool->entries[i];
+    if (entry->clip_id == clip_id && decoder_pool_entry_is_open(entry)) {
+      result = entry;
+      break;
+    }
+  }
+  return result;
+}
+
+// Marks the clip's entry as used this frame, so requests made before the clip
+// is presented can't evict it.
+static void decoder_pool_touch(Decoder_Pool *pool, u32 clip_id) {
+  Decoder_Pool_Entry *entry = decoder_pool_find(pool, clip_id);
+  if (entry) {
+    entry->last_used = pool->frame;
+  }
+}
+
+// Returns the entry for the clip, opening it in the background if needed. The
+// entry's decoder may only be used once it is READY. NULL if the pool is full.
+// When the clip's path changed, e.g. it switched to or from its proxy, the old
+// entry is closed and the new file opened in its place.
+static Decoder_Pool_Entry *decoder_pool_request(Decoder_Pool *pool, u32 clip_id, const char *path, f64 start_sec) {
+  ProfileFuncBegin();
+
+  Decoder_Pool_Entry *result = decoder_pool_find(pool, clip_id);
+  if (result && strcmp(result->path, path) != 0) {
+    if (result->state.load(std::memory_order_acquire) == DECODER_POOL_STATE__OPENING) {
+      // the pool thread still owns it, close it once it is ready
+      ProfileEnd();
+      return NULL;
+    }
+    decoder_pool_set_state(pool, result, DECODER_POOL_STATE__CLOSING);
+    result = NULL;
+  }
+
+  if (result == NULL) {
+    for (u32 i = 0; i < DECODER_POOL_MAX_ENTRIES; ++i) {
+      Decoder_Pool_Entry *entry = &pool->entries[i];
+      if (entry->clip_id == clip_id && strcmp(entry->path, path) == 0 &&
+          entry->state.load(std::memory_order_acquire) == DECODER_POOL_STATE__FAILED) {
+        result = entry;
+        break;
+      }
+    }
+  }
+
+  if (result == NULL) {
+    decoder_pool_evict(pool, 1);
+
+    for (u32 i = 0; i < DECODER_POOL_MAX_ENTRIES && result == NULL; ++i) {
+      Decoder_Pool_Entry *entry = &pool->entries[i];
+      u32 state = entry->state.load(std::memory_order_acquire);
+      if (state == DECODER_POOL_STATE__FAILED && entry->last_used != pool->frame) {
+        // retry failed opens once their slot is needed
+        entry->state.store(DECODER_POOL_STATE__FREE, std::memory_order_relaxed);
+        state = DECODER_POOL_STATE__FREE;
+      }
+      if (state == DECODER_POOL_STATE__FREE) {
+        result = entry;
+      }
+    }
+
+    if (result) {
+      result->clip_id = clip_id;
+      snprintf(result->path, MAX_PATH_LENGTH, "%s", path);
+      result->start_sec = start_sec;
+      result->is_budgeted = false;
+      decoder_pool_set_state(pool, result, DECODER_POOL_STATE__OPENING);
+      pool->opens++;
+    }
+  }
+
+  if (result) {
+    result->last_used = pool->frame;
+
+    // an entry's size is only known once the pool thread opened it, make room
+    // for it then
+    if (!result->is_budgeted && result->state.load(std::memory_order_acquire) == DECODER_POOL_STATE__READY) {
+      result->is_budgeted = true;
+      decoder_pool_evict(pool, 0);
+    }
+  }
+
+  ProfileEnd();
+
+  return result;
+}
+
+static inline bool decoder_pool_entry_is_ready(Decoder_Pool_Entry *entry) {
+  return entry && entry->state.load(std::memory_order_acquire) == DECODER_POOL_STATE__READY;
+}
+
+static void decoder_pool_debug_ui(Decoder_Pool *pool) {
+  ProfileFuncBegin();
+
+  static const char *state_names[] = { "free", "opening", "ready", "closing", "failed" };
+
+  if (ImGui::Begin("Decoder Pool")) {
+    ImGui::SliderInt("max open", &pool->max_open, 1, DECODER_POOL_MAX_ENTRIES);
+    f32 budget_mb = (f32)pool->budget / MiB(1);
+    if (ImGui::DragFloat("budget (MB)", &budget_mb, 1.0f, 16.0f, 8192.0f, "%.0f")) {
+      pool->budget = (u64)(budget_mb * MiB(1));
+    }
+    ImGui::Text("opens: %llu, evictions: %llu, not ready: %llu", pool->opens, pool->evictions, pool->not_ready);
+
+    for (u32 i = 0; i < DECODER_POOL_MAX_ENTRIES; ++i) {
+      Decoder_Pool_Entry *entry = &pool->entries[i];
+      u32 state = entry->state.load(std::memory_order_relaxed);
+      if (state == DECODER_POOL_STATE__FREE) continue;
+      ImGui::Text("clip %u: %s, %.1f MB, idle %llu frames, %s", entry->clip_id, state_names[state],
+                  (f64)entry->bytes / MiB(1), pool->frame - entry->last_used, entry->path);
+    }
+  }
+  ImGui::End();
+
+  ProfileEnd();
+}
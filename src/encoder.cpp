@@ -0,0 +1,176 @@
+// Sends everything the encoder has ready to the muxer.
+static void encoder_write_packets(Encoder *enc) {
+  ProfileFuncBegin();
+
+  for (;;) {
+    s32 response = avcodec_receive_packet(enc->codec_ctx, enc->packet);
+    if (response == AVERROR(EAGAIN) || response == AVERROR_EOF) {
+      break;
+    } else if (response < 0) {
+      chk_err(response);
+      break;
+    }
+
+    av_packet_rescale_ts(enc->packet, enc->codec_ctx->time_base, enc->stream->time_base);
+    enc->packet->stream_index = enc->stream->index;
+    chk_err(av_interleaved_write_frame(enc->fmt_ctx, enc->packet));
+  }
+
+  ProfileEnd();
+}
+
+static bool encoder_open(Encoder *enc, const char *path, Encoder_Params *params) {
+  ProfileFuncBegin();
+
+  *enc = {0};
+  u32 width = params->width;
+  u32 height = params->height;
+  AVRational frame_rate = params->frame_rate;
+  enc->width = width;
+  enc->height = height;
+
+  const AVCodec *codec = NULL;
+  switch (params->preset) {
+    case ENCODER_PRESET__EXPORT: {
+      // prefer x264, fall back to whatever h264/mpeg4 encoder this ffmpeg has
+      codec = avcodec_find_encoder_by_name("libx264");
+      if (codec == NULL) codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+      if (codec == NULL) codec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+    } break;
+    case ENCODER_PRESET__PROXY: {
+      codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+    } break;
+  }
+
+  avformat_alloc_output_context2(&enc->fmt_ctx, NULL, NULL, path);
+  if (codec == NULL || enc->fmt_ctx == NULL) {
+    fprintf(stderr, "Could not set up an encoder for '%s'\n", path);
+    avformat_free_context(enc->fmt_ctx);
+    enc->fmt_ctx = NULL;
+    ProfileEnd();
+    return false;
+  }
+
+  enc->stream = avformat_new_stream(enc->fmt_ctx, NULL);
+  enc->codec_ctx = avcodec_alloc_context3(codec);
+
+  AVCodecContext *codec_ctx = enc->codec_ctx;
+  codec_ctx->width = width;
+  codec_ctx->height = height;
+  codec_ctx->framerate = frame_rate;
+  codec_ctx->time_base = params->time_base.num > 0 ? params->time_base : av_inv_q(frame_rate);
+  codec_ctx->thread_count = 0;
+
+  switch (params->preset) {
+    case ENCODER_PRESET__EXPORT: {
+      codec_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+      codec_ctx->gop_size = Max(1, (s32)(2 * av_q2d(frame_rate)));
+      codec_ctx->bit_rate = 8000000;
+      if (strcmp(codec->name, "libx264") == 0) {
+        av_opt_set(codec_ctx->priv_data, "preset", "veryfast", 0);
+        av_opt_set(codec_ctx->priv_data, "crf", "20", 0);
+      }
+    } break;
+    case ENCODER_PRESET__PROXY: {
+      // full range 4:2:0, decodes straight into the native YUV420P upload path
+      codec_ctx->pix_fmt = AV_PIX_FMT_YUVJ420P;
+      codec_ctx->color_range = AVCOL_RANGE_JPEG;
+      codec_ctx->gop_size = 1;
+      codec_ctx->flags |= AV_CODEC_FLAG_QSCALE;
+      codec_ctx->global_quality = FF_QP2LAMBDA * 5;
+    } break;
+  }
+
+  if (enc->fmt_ctx->oformat->flags & AVFMT_GLOBALHEADER) {
+    codec_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+  }
+
+  bool result = false;
+  if (avcodec_open2(codec_ctx, codec, NULL) >= 0) {
+    chk_err(avcodec_parameters_from_context(enc->stream->codecpar, codec_ctx));
+    enc->stream->time_base = codec_ctx->time_base;
+
+    if (!(enc->fmt_ctx->oformat->flags & AVFMT_NOFILE)) {
+      chk_err(avio_open(&enc->fmt_ctx->pb, path, AVIO_FLAG_WRITE));
+    }
+
+    if (avformat_write_header(enc->fmt_ctx, NULL) >= 0) {
+      enc->frame = av_frame_alloc();
+      enc->frame->format = codec_ctx->pix_fmt;
+      enc->frame->width = width;
+      enc->frame->height = height;
+      chk_err(av_frame_get_buffer(enc->frame, 0));
+
+      enc->packet = av_packet_alloc();
+
+      printf("encoder: %s %ux%u @ %.3f fps -> '%s'\n", codec->name, width, height, av_q2d(frame_rate), path);
+      result = true;
+    }
+  }
+
+  if (!result) {
+    fprintf(stderr, "Could not open encoder for '%s'\n", path);
+    avcodec_free_context(&enc->codec_ctx);
+    if (enc->fmt_ctx->pb) avio_closep(&enc->fmt_ctx->pb);
+    avformat_free_context(enc->fmt_ctx);
+    enc->fmt_ctx = NULL;
+  }
+
+  ProfileEnd();
+
+  return result;
+}
+
+// Converts and scales the planes to the encoder's format and size, then encodes
+// them with pts in the encoder's time base.
+static void encoder_write_frame(Encoder *enc, const u8 *const *data, const s32 *linesize,
+                                AVPixelFormat format, u32 width, u32 height, s64 pts) {
+  ProfileFuncBegin();
+
+  chk_err(av_frame_make_writable(enc->frame));
+
+  enc->sws_ctx = sws_getCachedContext(enc->sws_ctx, width, height, format,
+                                      enc->width, enc->height, enc->codec_ctx->pix_fmt,
+                                      SWS_BILINEAR, NULL, NULL, NULL);
+  sws_scale(enc->sws_ctx, data, linesize, 0, height, enc->frame->data, enc->frame->linesize);
+
+  enc->frame->pts = pts;
+  enc->frame_index++;
+  chk_err(avcodec_send_frame(enc->codec_ctx, enc->frame));
+  encoder_write_packets(enc);
+
+  ProfileEnd();
+}
+
+// Encodes one RGBA frame of the encoder's size as the next frame. The render
+// target holds the top row of the image first, so a readback needs no flip.
+static void encoder_write_rgba(Encoder *enc, u8 *pixels) {
+  s32 stride = (s32)enc->width * 4;
+  const u8 *src[4] = { pixels, NULL, NULL, NULL };
+  s32 src_stride[4] = { stride, 0, 0, 0 };
+  encoder_write_frame(enc, src, src_stride, AV_PIX_FMT_RGBA, enc->width, enc->height, enc->frame_index);
+}
+
+// Flushes the encoder and finishes the file.
+static void encoder_close(Encoder *enc) {
+  ProfileFuncBegin();
+
+  if (enc->fmt_ctx) {
+    avcodec_send_frame(enc->codec_ctx, NULL);
+    encoder_write_packets(enc);
+    chk_err(av_write_trailer(enc->fmt_ctx));
+
+    if (!(enc->fmt_ctx->oformat->flags & AVFMT_NOFILE)) {
+      avio_closep(&enc->fmt_ctx->pb);
+    }
+
+    sws_freeContext(enc->sws_ctx);
+    av_packet_free(&enc->packet);
+    av_frame_free(&enc->frame);
+    avcodec_free_context(&enc->codec_ctx);
+    avformat_free_context(enc->fmt_ctx);
+    *enc = {0};
+  }
+
+  ProfileEnd();
+}
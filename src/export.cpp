@@ -0,0 +1,330 @@
+static void export_print_usage(const char *program) {
+  fprintf(stderr, "usage: %s --export <output.mp4> [--input <video>]... [--size <width>x<height>] "
+                  "[--start <sec>] [--end <sec>] [--captions <file>]\n", program);
+}
+
+// Returns true if the command line asks for a headless export. Exits on bad arguments.
+static bool export_parse_args(s32 argc, char **argv, Export_Params *params) {
+  *params = {0};
+  params->width = PROJECT_DEFAULT_WIDTH;
+  params->height = PROJECT_DEFAULT_HEIGHT;
+
+  bool result = false;
+  for (s32 i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+    if (value == NULL) {
+      export_print_usage(argv[0]);
+      exit(1);
+    }
+
+    if (strcmp(arg, "--export") == 0) {
+      snprintf(params->output_path, MAX_PATH_LENGTH, "%s", value);
+      result = true;
+    } else if (strcmp(arg, "--input") == 0) {
+      if (params->num_inputs == EXPORT_MAX_INPUTS) {
+        fprintf(stderr, "at most %d --input videos\n", EXPORT_MAX_INPUTS);
+        exit(1);
+      }
+      snprintf(params->input_paths[params->num_inputs++], MAX_PATH_LENGTH, "%s", value);
+    } else if (strcmp(arg, "--size") == 0) {
+      // the encoder needs even dimensions
+      if (sscanf(value, "%ux%u", &params->width, &params->height) != 2 ||
+          params->width < 2 || params->height < 2 || params->width % 2 || params->height % 2) {
+        fprintf(stderr, "--size takes even dimensions like 1080x1920\n");
+        exit(1);
+      }
+    } else if (strcmp(arg, "--start") == 0) {
+      params->start_time = atof(value);
+    } else if (strcmp(arg, "--end") == 0) {
+      params->end_time = atof(value);
+    } else if (strcmp(arg, "--captions") == 0) {
+      snprintf(params->captions_path, MAX_PATH_LENGTH, "%s", value);
+    } else {
+      export_print_usage(argv[0]);
+      exit(1);
+    }
+    ++i;
+  }
+
+  if (params->num_inputs == 0) {
+    snprintf(params->input_paths[params->num_inputs++], MAX_PATH_LENGTH, "%s", "./videos/jackal.mp4");
+  }
+
+  return result;
+}
+
+// Waits for the oldest frame in flight and encodes it.
+static bool export_encode_readback(Readback_Ring *readback, Encoder *encoder) {
+  u8 *pixels = readback_ring_map(readback, true);
+  if (pixels) {
+    encoder_write_rgba(encoder, pixels);
+    readback_ring_unmap(readback);
+  } else {
+    fprintf(stderr, "export: readback failed\n");
+  }
+  return pixels != NULL;
+}
+
+
+// Returns the clip's decoder, opening it at the source time shown at time.
+// NULL if it failed to open or there are already RENDERER_MAX_LAYERS open.
+static Export_Clip *export_clip_get(Export_Clip *clips, Timeline *tl, Timeline_Clip *clip, f64 time) {
+  Export_Clip *result = NULL;
+  Export_Clip *free_clip = NULL;
+  for (u32 i = 0; i < RENDERER_MAX_LAYERS && result == NULL; ++i) {
+    if (clips[i].is_used && clips[i].clip_id == clip->id) result = &clips[i];
+    else if (!clips[i].is_used && free_clip == NULL) free_clip = &clips[i];
+  }
+
+  if (result == NULL && free_clip) {
+    result = free_clip;
+    memset(result, 0, sizeof(Export_Clip));
+    result->is_used = true;
+    result->clip_id = clip->id;
+
+    // always the source, proxies are only for the preview
+    const char *path = tl->sources[clip->source].path;
+    if (video_open(&result->video, path, VIDEO_OPEN_FLAG__FULL_QUALITY | VIDEO_OPEN_FLAG__NO_KEYFRAME_INDEX)) {
+      Video *video = &result->video;
+      video_decoder_slot_init(&result->slot, "export frames");
+      result->texture = create_yuv_texture(video->width, video->height, video->layout);
+
+      video_seek(video, clip->in_point + (time - clip->start));
+      result->end_of_stream = video->frame->data[0] == NULL;
+      if (!result->end_of_stream) {
+        result->decoded_end = video->frame->best_effort_timestamp + video_frame_duration(video, video->frame);
+      }
+    } else {
+      fprintf(stderr, "export: could not open '%s', its clip is left out\n", path);
+      result->is_failed = true;
+    }
+  }
+
+  return result && !result->is_failed ? result : NULL;
+}
+
+static void export_clip_close(Export_Clip *clip) {
+  if (!clip->is_failed) {
+    destroy_yuv_texture(&clip->texture);
+    video_decoder_slot_shutdown(&clip->slot);
+    video_close(&clip->video);
+  }
+  memset(clip, 0, sizeof(Export_Clip));
+}
+
+// Frame rate of the output, taken from the first source that has one.
+static AVRational export_frame_rate(Timeline *tl) {
+  AVRational result = {30, 1};
+  for (u32 i = 0; i < tl->num_sources; ++i) {
+    Video probe = {0};
+    if (video_open(&probe, tl->sources[i].path, VIDEO_OPEN_FLAG__KEYFRAMES_ONLY)) {
+      bool has_rate = probe.frame_rate.num > 0;
+      if (has_rate) result = probe.frame_rate;
+      video_close(&probe);
+      if (has_rate) break;
+    }
+  }
+  return result;
+}
+
+// Renders the timeline the way the preview composites it, every visible clip a
+// layer with its transform and effects, and encodes it to params->output_path
+// at params' size. Needs a current GL context, the renderer's target is resized.
+// captions may be NULL. Returns the process exit code.
+static s32 export_timeline(Renderer *renderer, Timeline *tl, Captions *captions, Export_Params *params) {
+  ProfileFuncBegin();
+
+  renderer_resize(renderer, params->width, params->height);
+  Render_Target *target = &renderer->target;
+
+  AVRational frame_rate = export_frame_rate(tl);
+  f64 end_time = timeline_duration(tl);
+  if (params->end_time > 0.0) end_time = Min(end_time, params->end_time);
+  s64 frame_count = (s64)((end_time - params->start_time) * av_q2d(frame_rate));
+
+  Encoder_Params encoder_params = {
+    .preset = ENCODER_PRESET__EXPORT,
+    .width = target->width,
+    .height = target->height,
+    .frame_rate = frame_rate,
+  };
+
+  s32 result = 1;
+  Encoder encoder;
+  if (frame_count > 0 && encoder_open(&encoder, params->output_path, &encoder_params)) {
+    Readback_Ring readback;
+    readback_ring_init(&readback, target->width, target->height);
+
+    Export_Clip clips[RENDERER_MAX_LAYERS];
+    memset(clips, 0, sizeof(clips));
+
+    f64 start_wall_time = glfwGetTime();
+    f64 last_report_time = start_wall_time;
+
+    s64 i = 0;
+    for (; i < frame_count; ++i) {
+      f64 time = params->start_time + i / av_q2d(frame_rate);
+
+      for (u32 j = 0; j < RENDERER_MAX_LAYERS; ++j) {
+        clips[j].is_visible = false;
+      }
+
+      renderer_begin_layers(renderer);
+
+      u32 *results;
+      u32 count = timeline_query(tl, time, time + 1e-9, &results);
+      for (u32 j = 0; j < count; ++j) {
+        Timeline_Clip *clip = &tl->clips[results[j]];
+        if (tl->tracks[clip->track].is_hidden) continue;
+
+        Export_Clip *export_clip = export_clip_get(clips, tl, clip, time);
+        if (export_clip == NULL) continue;
+        export_clip->is_visible = true;
+
+        // decode forward to the frame that is visible at pts, it stays up
+        // until the source moves on (output frames are repeated or dropped)
+        Video *video = &export_clip->video;
+        s64 pts = video_sec_to_pts(video, clip->in_point + (time - clip->start));
+        bool is_new = !export_clip->has_texture;
+        while (!export_clip->end_of_stream && export_clip->decoded_end <= pts) {
+          export_clip->end_of_stream = !video_decode_next(video);
+          if (!export_clip->end_of_stream) {
+            export_clip->decoded_end = video->frame->best_effort_timestamp + video_frame_duration(video, video->frame);
+          }
+          is_new = true;
+        }
+
+        if (is_new && !export_clip->end_of_stream) {
+          video_decoder_fill_slot(video, &export_clip->slot);
+          upload_frame_to_texture(renderer, &export_clip->texture, export_clip->slot.frame);
+          export_clip->has_texture = true;
+        }
+
+        if (export_clip->has_texture) {
+          renderer_push_layer(renderer, export_clip->texture, &clip->transform, &clip->effects, clip->track);
+        }
+      }
+
+      // encode the oldest frame in flight to make room, by now the GPU is
+      // usually done with it and the map doesn't wait
+      if (readback_ring_count(&readback) == READBACK_RING_SIZE &&
+          !export_encode_readback(&readback, &encoder)) {
+        break;
+      }
+
+      // clears the target in gaps between clips
+      renderer_draw_layers(renderer);
+      if (captions) captions_draw(captions, target, time);
+      readback_ring_push(&readback, target);
+
+      for (u32 j = 0; j < RENDERER_MAX_LAYERS; ++j) {
+        if (clips[j].is_used && !clips[j].is_visible) export_clip_close(&clips[j]);
+      }
+
+      f64 now = glfwGetTime();
+      if (now - last_report_time >= 1.0) {
+        printf("export: %lld/%lld frames\n", i + 1, frame_count);
+        last_report_time = now;
+        arena_profile_counters();
+        profile_new_frame();
+      }
+    }
+
+    while (readback_ring_count(&readback) > 0 && export_encode_readback(&readback, &encoder)) {
+    }
+    s64 encoded = encoder.frame_index;
+    encoder_close(&encoder);
+
+    f64 elapsed = glfwGetTime() - start_wall_time;
+    f64 exported = i / av_q2d(frame_rate);
+    printf("export: %lld frames (%.2fs) in %.2fs, %.2fx realtime, %llu readback stalls\n",
+           encoded, exported, elapsed, elapsed > 0.0 ? exported / elapsed : 0.0, readback.stalls);
+    result = encoded == frame_count ? 0 : 1;
+
+    for (u32 j = 0; j < RENDERER_MAX_LAYERS; ++j) {
+      if (clips[j].is_used) export_clip_close(&clips[j]);
+    }
+    readback_ring_shutdown(&readback);
+  }
+
+  ProfileEnd();
+
+  return result;
+}
+
+// Exports the inputs cut one after another on a single track, without a
+// visible window. Returns the process exit code.
+static s32 export_run(Export_Params *params) {
+  ProfileFuncBegin();
+
+  if (!glfwInit()) {
+    fprintf(stderr, "Could not initialize GLFW\n");
+    ProfileEnd();
+    return 1;
+  }
+
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+  // never shown, it only provides the GL context
+  GLFWwindow *window = glfwCreateWindow(64, 64, "Golden Grouse Export", NULL, NULL);
+  if (window == NULL) {
+    fprintf(stderr, "Could not create an OpenGL context\n");
+    glfwTerminate();
+    ProfileEnd();
+    return 1;
+  }
+  glfwMakeContextCurrent(window);
+  gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+
+  Renderer renderer = {0};
+  renderer_init(&renderer, params->width, params->height);
+
+  Captions captions;
+  captions_init(&captions, CAPTION_DEFAULT_FONT);
+  if (params->captions_path[0] && !captions_load(&captions, params->captions_path)) {
+    fprintf(stderr, "export: could not load captions '%s'\n", params->captions_path);
+  }
+
+  Timeline timeline;
+  timeline_init(&timeline);
+  u32 track = timeline_add_track(&timeline, "V1");
+
+  s32 result = 1;
+  bool has_inputs = true;
+  f64 start = 0.0;
+  for (u32 i = 0; i < params->num_inputs && has_inputs; ++i) {
+    // only probed for the duration, export_timeline decodes the clips
+    Video probe = {0};
+    has_inputs = video_open(&probe, params->input_paths[i], VIDEO_OPEN_FLAG__KEYFRAMES_ONLY);
+    if (has_inputs) {
+      f64 duration = video_duration(&probe);
+      u32 source = timeline_add_source(&timeline, params->input_paths[i], duration);
+      timeline_add_clip(&timeline, source, track, start, 0.0, duration);
+      start += duration;
+      video_close(&probe);
+    } else {
+      fprintf(stderr, "export: could not open '%s'\n", params->input_paths[i]);
+    }
+  }
+
+  if (has_inputs) {
+    result = export_timeline(&renderer, &timeline, &captions, params);
+  }
+
+  timeline_shutdown(&timeline);
+  captions_shutdown(&captions);
+  renderer_shutdown(&renderer);
+  frame_pools_shutdown();
+  glfwDestroyWindow(window);
+  glfwTerminate();
+
+  ProfileEnd();
+
+  return result;
+}
@@ -0,0 +1,178 @@
+static void frame_cache_init(Frame_Cache *cache, u64 budget) {
+  *cache = {0};
+  cache->budget = budget;
+}
+
+static void frame_cache_unlink(Frame_Cache *cache, Frame_Cache_Entry *entry) {
+  if (entry->prev) entry->prev->next = entry->next;
+  else cache->most_recent = entry->next;
+
+  if (entry->next) entry->next->prev = entry->prev;
+  else cache->least_recent = entry->prev;
+
+  entry->prev = NULL;
+  entry->next = NULL;
+}
+
+static void frame_cache_push_front(Frame_Cache *cache, Frame_Cache_Entry *entry) {
+  entry->prev = NULL;
+  entry->next = cache->most_recent;
+  if (cache->most_recent) cache->most_recent->prev = entry;
+  else cache->least_recent = entry;
+  cache->most_recent = entry;
+}
+
+static inline bool frame_cache_entry_covers(Frame_Cache_Entry *entry, u64 source_id, s64 pts) {
+  return entry->is_used && entry->source_id == source_id &&
+         entry->pts <= pts && pts < entry->pts + entry->duration;
+}
+
+// Unlinks the entry but keeps its texture around, the caller either reuses or destroys it.
+static void frame_cache_remove(Frame_Cache *cache, Frame_Cache_Entry *entry) {
+  frame_cache_unlink(cache, entry);
+  entry->is_used = false;
+  cache->bytes_used -= entry->bytes;
+  cache->count--;
+}
+
+// Evicts least recently used frames until extra_bytes fit in the budget.
+// Returns an evicted entry whose texture matches width x height and layout, if there was one.
+static Frame_Cache_Entry *frame_cache_evict(Frame_Cache *cache, u64 extra_bytes, u32 width, u32 height,
+                                            Pixel_Layout layout) {
+  ProfileFuncBegin();
+
+  Frame_Cache_Entry *reusable = NULL;
+  while (cache->least_recent &&
+         (cache->bytes_used + extra_bytes > cache->budget || cache->count == FRAME_CACHE_MAX_ENTRIES)) {
+    Frame_Cache_Entry *victim = cache->least_recent;
+    frame_cache_remove(cache, victim);
+    cache->evictions++;
+
+    if (reusable == NULL && victim->texture.width == width && victim->texture.height == height &&
+        victim->texture.layout == layout) {
+      reusable = victim;
+    } else {
+      destroy_yuv_texture(&victim->texture);
+    }
+  }
+
+  ProfileEnd();
+
+  return reusable;
+}
+
+// Like frame_cache_lookup, but leaves the LRU order and the stats alone.
+static bool frame_cache_contains(Frame_Cache *cache, u64 source_id, s64 pts) {
+  bool result = false;
+  for (Frame_Cache_Entry *it = cache->most_recent; it != NULL && !result; it = it->next) {
+    result = frame_cache_entry_covers(it, source_id, pts);
+  }
+  return result;
+}
+
+// Returns the cached frame visible at pts and marks it as recently used.
+static Frame_Cache_Entry *frame_cache_lookup(Frame_Cache *cache, u64 source_id, s64 pts) {
+  ProfileFuncBegin();
+
+  // a few hundred entries at most, a linear scan is fine
+  Frame_Cache_Entry *result = NULL;
+  for (Frame_Cache_Entry *it = cache->most_recent; it != NULL; it = it->next) {
+    if (frame_cache_entry_covers(it, source_id, pts)) {
+      result = it;
+      break;
+    }
+  }
+
+  if (result) {
+    frame_cache_unlink(cache, result);
+    frame_cache_push_front(cache, result);
+    cache->hits++;
+  } else {
+    cache->misses++;
+  }
+
+  ProfileEnd();
+
+  return result;
+}
+
+// Makes room for frame and returns its entry, the caller uploads into entry->texture.
+static Frame_Cache_Entry *frame_cache_insert(Frame_Cache *cache, u64 source_id, Video_Frame_YUV *frame) {
+  ProfileFuncBegin();
+
+  u64 bytes = yuv_frame_bytes(frame->width, frame->height, frame->layout);
+  Frame_Cache_Entry *entry = frame_cache_evict(cache, bytes, frame->width, frame->height, frame->layout);
+
+  if (entry == NULL) {
+    for (u32 i = 0; i < FRAME_CACHE_MAX_ENTRIES; ++i) {
+      if (!cache->entries[i].is_used) {
+        entry = &cache->entries[i];
+        break;
+      }
+    }
+    entry->texture = create_yuv_texture(frame->width, frame->height, frame->layout);
+  }
+
+  entry->is_used = true;
+  entry->source_id = source_id;
+  entry->pts = frame->pts;
+  entry->duration = frame->duration;
+  entry->bytes = bytes;
+
+  cache->bytes_used += bytes;
+  cache->count++;
+  frame_cache_push_front(cache, entry);
+
+  ProfileEnd();
+
+  return entry;
+}
+
+static void frame_cache_clear(Frame_Cache *cache) {
+  ProfileFuncBegin();
+
+  while (cache->least_recent) {
+    Frame_Cache_Entry *entry = cache->least_recent;
+    frame_cache_remove(cache, entry);
+    destroy_yuv_texture(&entry->texture);
+  }
+
+  ProfileEnd();
+}
+
+static void frame_cache_shutdown(Frame_Cache *cache) {
+  frame_cache_clear(cache);
+}
+
+static void frame_cache_debug_ui(Frame_Cache *cache) {
+  ProfileFuncBegin();
+
+  if (ImGui::Begin("Frame Cache")) {
+    u64 lookups = cache->hits + cache->misses;
+    f32 hit_rate = lookups ? (f32)cache->hits / (f32)lookups : 0.0f;
+
+    ImGui::Text("hits: %llu, misses: %llu (%.1f%%)", cache->hits, cache->misses, hit_rate * 100.0f);
+    ImGui::Text("evictions: %llu", cache->evictions);
+    ImGui::Text("frames: %u, %.1f / %.1f MiB", cache->count,
+                cache->bytes_used / (f64)MiB(1), cache->budget / (f64)MiB(1));
+
+    s32 budget_mib = (s32)(cache->budget / MiB(1));
+    if (ImGui::SliderInt("budget (MiB)", &budget_mib, 0, 4096)) {
+      cache->budget = (u64)budget_mib * MiB(1);
+      frame_cache_evict(cache, 0, 0, 0, PIXEL_LAYOUT__YUV420P);
+    }
+
+    if (ImGui::Button("Clear")) {
+      frame_cache_clear(cache);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Reset stats")) {
+      cache->hits = 0;
+      cache->misses = 0;
+      cache->evictions = 0;
+    }
+  }
+  ImGui::End();
+
+  ProfileEnd();
+}
@@ -0,0 +1,240 @@
+static Frame_Pools frame_pools = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+static const char *pixel_layout_names[NUM_PIXEL_LAYOUTS] = {
+  "YUV420P",
+  "YUV420P10",
+  "NV12",
+  "P010",
+};
+
+static void frame_pool_init(Frame_Pool *pool, u32 width, u32 height, Pixel_Layout layout) {
+  const Pixel_Layout_Info *info = &pixel_layout_infos[layout];
+
+  pool->width = width;
+  pool->height = height;
+  pool->layout = layout;
+  pool->y_stride = AlignPow2(width * info->bytes_per_sample, FRAME_POOL_ALIGNMENT);
+  u32 uv_row_size = chroma_size(width) * info->bytes_per_sample * info->chroma_channels;
+  pool->uv_stride = AlignPow2(uv_row_size, FRAME_POOL_ALIGNMENT);
+
+  u64 size = AlignPow2(sizeof(Frame_Buffer), FRAME_POOL_ALIGNMENT);
+  size += AlignPow2((u64)pool->y_stride * height, FRAME_POOL_ALIGNMENT);
+  size += AlignPow2((u64)pool->uv_stride * chroma_size(height), FRAME_POOL_ALIGNMENT) * (info->num_planes - 1);
+  pool->buffer_size = size;
+
+  pthread_mutex_init(&pool->mutex, NULL);
+  pool->arena = arena_alloc((Arena_Params){
+    .name = "frame pool",
+    .flags = ARENA_FLAG__LARGE_PAGES,
+    .reserve_size = ARENA_DEFAULT_RESERVE_SIZE,
+    .commit_size = MiB(2),
+  });
+}
+
+// Returns the pool for frames of this size and layout, creating it on first
+// use. NULL once FRAME_POOL_MAX_POOLS pools exist.
+static Frame_Pool *frame_pool_get(u32 width, u32 height, Pixel_Layout layout) {
+  // pools are never removed, the ones below count can be read without the lock
+  Frame_Pool *result = NULL;
+  u32 count = frame_pools.count.load(std::memory_order_acquire);
+  for (u32 i = 0; i < count && result == NULL; ++i) {
+    Frame_Pool *pool = &frame_pools.pools[i];
+    if (pool->width == width && pool->height == height && pool->layout == layout) result = pool;
+  }
+
+  if (result == NULL) {
+    pthread_mutex_lock(&frame_pools.mutex);
+
+    // another thread may have created it in the meantime
+    count = frame_pools.count.load(std::memory_order_relaxed);
+    for (u32 i = 0; i < count && result == NULL; ++i) {
+      Frame_Pool *pool = &frame_pools.pools[i];
+      if (pool->width == width && pool->height == height && pool->layout == layout) result = pool;
+    }
+
+    if (result == NULL && count < FRAME_POOL_MAX_POOLS) {
+      result = &frame_pools.pools[count];
+      frame_pool_init(result, width, height, layout);
+      frame_pools.count.store(count + 1, std::memory_order_release);
+    }
+
+    pthread_mutex_unlock(&frame_pools.mutex);
+  }
+
+  return result;
+}
+
+// Carves a new buffer out of the pool's arena, NULL if the pool is at FRAME_POOL_MAX_BUFFERS.
+static Frame_Buffer *frame_pool_grow(Frame_Pool *pool) {
+  ProfileFuncBegin();
+
+  const Pixel_Layout_Info *info = &pixel_layout_infos[pool->layout];
+  Frame_Buffer *result = NULL;
+
+  pthread_mutex_lock(&pool->mutex);
+  u32 index = pool->num_buffers.load(std::memory_order_relaxed);
+  if (index < FRAME_POOL_MAX_BUFFERS) {
+    u8 *memory = push_array_no_zero_aligned(pool->arena, u8, pool->buffer_size, FRAME_POOL_ALIGNMENT);
+    result = (Frame_Buffer *)memory;
+    memset(result, 0, sizeof(Frame_Buffer));
+    result->pool = pool;
+    result->index = index;
+
+    u8 *plane = memory + AlignPow2(sizeof(Frame_Buffer), FRAME_POOL_ALIGNMENT);
+    for (u32 i = 0; i < info->num_planes; ++i) {
+      result->planes[i] = plane;
+      u64 plane_size = i == 0 ? (u64)pool->y_stride * pool->height : (u64)pool->uv_stride * chroma_size(pool->height);
+      plane += AlignPow2(plane_size, FRAME_POOL_ALIGNMENT);
+    }
+
+    pool->buffers[index] = result;
+    pool->num_buffers.store(index + 1, std::memory_order_release);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  ProfileEnd();
+
+  return result;
+}
+
+static Frame_Buffer *frame_pool_pop(Frame_Pool *pool) {
+  Frame_Buffer *result = NULL;
+  u64 head = pool->free_head.load(std::memory_order_acquire);
+  while ((u32)head != 0) {
+    Frame_Buffer *buffer = pool->buffers[(u32)head - 1];
+    u64 new_head = (((head >> 32) + 1) << 32) | buffer->next.load(std::memory_order_relaxed);
+    if (pool->free_head.compare_exchange_weak(head, new_head, std::memory_order_acquire,
+                                              std::memory_order_acquire)) {
+      result = buffer;
+      break;
+    }
+  }
+  return result;
+}
+
+static void frame_pool_push(Frame_Pool *pool, Frame_Buffer *buffer) {
+  u64 head = pool->free_head.load(std::memory_order_relaxed);
+  u64 new_head;
+  do {
+    buffer->next.store((u32)head, std::memory_order_relaxed);
+    new_head = (((head >> 32) + 1) << 32) | (buffer->index + 1);
+  } while (!pool->free_head.compare_exchange_weak(head, new_head, std::memory_order_release,
+                                                  std::memory_order_relaxed));
+}
+
+// Returns a buffer holding one reference, or NULL if all FRAME_POOL_MAX_BUFFERS
+// are in use. The planes are not cleared.
+static Frame_Buffer *frame_pool_acquire(Frame_Pool *pool) {
+  Frame_Buffer *result = frame_pool_pop(pool);
+  if (result == NULL) {
+    result = frame_pool_grow(pool);
+  }
+
+  pool->acquires.fetch_add(1, std::memory_order_relaxed);
+  if (result) {
+    result->ref_count.store(1, std::memory_order_relaxed);
+    pool->in_use.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    pool->exhausted.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  return result;
+}
+
+static void frame_buffer_retain(Frame_Buffer *buffer) {
+  buffer->ref_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+// The last release hands the buffer back to its pool, the planes must not be
+// touched after that.
+static void frame_buffer_release(Frame_Buffer *buffer) {
+  if (buffer->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    Frame_Pool *pool = buffer->pool;
+    pool->in_use.fetch_sub(1, std::memory_order_relaxed);
+    frame_pool_push(pool, buffer);
+  }
+}
+
+// Keeps the frame's planes alive after its producer moves on, until
+// video_frame_release. Returns false for planes that aren't pooled (they live
+// in an arena or a decoder frame), those are only valid as long as the producer says.
+static bool video_frame_retain(Video_Frame_YUV *frame) {
+  bool result = frame->buffer != NULL;
+  if (result) {
+    frame_buffer_retain(frame->buffer);
+  }
+  return result;
+}
+
+static void video_frame_release(Video_Frame_YUV *frame) {
+  if (frame->buffer) {
+    frame_buffer_release(frame->buffer);
+  }
+  *frame = {0};
+}
+
+// Buffers still referenced at this point leak with their arena, all frames
+// have to be released first.
+static void frame_pools_shutdown() {
+  ProfileFuncBegin();
+
+  pthread_mutex_lock(&frame_pools.mutex);
+  u32 count = frame_pools.count.load(std::memory_order_relaxed);
+  for (u32 i = 0; i < count; ++i) {
+    Frame_Pool *pool = &frame_pools.pools[i];
+    u32 in_use = pool->in_use.load(std::memory_order_relaxed);
+    if (in_use > 0) {
+      fprintf(stderr, "Frame pool %ux%u %s: %u buffers still in use at shutdown\n",
+              pool->width, pool->height, pixel_layout_names[pool->layout], in_use);
+    }
+    arena_release(pool->arena);
+    pthread_mutex_destroy(&pool->mutex);
+    pool->width = 0;
+    pool->height = 0;
+    pool->num_buffers.store(0, std::memory_order_relaxed);
+    pool->free_head.store(0, std::memory_order_relaxed);
+    pool->in_use.store(0, std::memory_order_relaxed);
+  }
+  frame_pools.count.store(0, std::memory_order_release);
+  pthread_mutex_unlock(&frame_pools.mutex);
+
+  ProfileEnd();
+}
+
+// Adds the pools to the memory window.
+static void frame_pools_debug_ui() {
+  ProfileFuncBegin();
+
+  if (ImGui::Begin("Memory")) {
+    ImGui::SeparatorText("frame pools");
+
+    ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
+    if (ImGui::BeginTable("frame pools", 6, flags)) {
+      ImGui::TableSetupColumn("frames");
+      ImGui::TableSetupColumn("buffers");
+      ImGui::TableSetupColumn("in use");
+      ImGui::TableSetupColumn("MB");
+      ImGui::TableSetupColumn("acquires");
+      ImGui::TableSetupColumn("exhausted");
+      ImGui::TableHeadersRow();
+
+      u32 count = frame_pools.count.load(std::memory_order_acquire);
+      for (u32 i = 0; i < count; ++i) {
+        Frame_Pool *pool = &frame_pools.pools[i];
+        u32 num_buffers = pool->num_buffers.load(std::memory_order_relaxed);
+
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn(); ImGui::Text("%ux%u %s", pool->width, pool->height, pixel_layout_names[pool->layout]);
+        ImGui::TableNextColumn(); ImGui::Text("%u", num_buffers);
+        ImGui::TableNextColumn(); ImGui::Text("%u", pool->in_use.load(std::memory_order_relaxed));
+        ImGui::TableNextColumn(); ImGui::Text("%.1f", (f64)(num_buffers * pool->buffer_size) / MiB(1));
+        ImGui::TableNextColumn(); ImGui::Text("%llu", pool->acquires.load(std::memory_order_relaxed));
+        ImGui::TableNextColumn(); ImGui::Text("%llu", pool->exhausted.load(std::memory_order_relaxed));
+      }
+      ImGui::EndTable();
+    }
+  }
+  ImGui::End();
+
+  ProfileEnd();
+}
@@ -0,0 +1,203 @@
+#include <sys/stat.h>
+
+static void keyframe_index_sidecar_path(Keyframe_Index *index, char *out, u32 out_size) {
+  snprintf(out, out_size, "%s.kfi", index->path);
+}
+
+static bool keyframe_index_load(Keyframe_Index *index, struct stat *source_stat) {
+  ProfileFuncBegin();
+
+  char sidecar[MAX_PATH_LENGTH + 8];
+  keyframe_index_sidecar_path(index, sidecar, sizeof(sidecar));
+
+  bool result = false;
+  FILE *file = fopen(sidecar, "rb");
+  if (file) {
+    Keyframe_Index_Header header = {0};
+    if (fread(&header, sizeof(header), 1, file) == 1 &&
+        header.magic == KEYFRAME_INDEX_MAGIC &&
+        header.version == KEYFRAME_INDEX_VERSION &&
+        header.stream_index == index->stream_index &&
+        header.source_size == (s64)source_stat->st_size &&
+        header.source_mtime == (s64)source_stat->st_mtime) {
+      Keyframe *keyframes = push_array_no_zero(index->arena, Keyframe, header.count);
+      if (keyframes && fread(keyframes, sizeof(Keyframe), header.count, file) == header.count) {
+        index->keyframes = keyframes;
+        index->count = header.count;
+        result = true;
+      }
+    }
+    fclose(file);
+  }
+
+  ProfileEnd();
+
+  return result;
+}
+
+static void keyframe_index_save(Keyframe_Index *index, struct stat *source_stat) {
+  ProfileFuncBegin();
+
+  char sidecar[MAX_PATH_LENGTH + 8];
+  keyframe_index_sidecar_path(index, sidecar, sizeof(sidecar));
+
+  FILE *file = fopen(sidecar, "wb");
+  if (file) {
+    Keyframe_Index_Header header = {
+      .magic = KEYFRAME_INDEX_MAGIC,
+      .version = KEYFRAME_INDEX_VERSION,
+      .stream_index = index->stream_index,
+      .source_size = (s64)source_stat->st_size,
+      .source_mtime = (s64)source_stat->st_mtime,
+      .count = index->count,
+    };
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(index->keyframes, sizeof(Keyframe), index->count, file);
+    fclose(file);
+  } else {
+    fprintf(stderr, "Could not write keyframe index '%s'\n", sidecar);
+  }
+
+  ProfileEnd();
+}
+
+// Demuxes (but doesn't decode) the whole file and records every keyframe packet.
+static void keyframe_index_scan(Keyframe_Index *index) {
+  ProfileFuncBegin();
+
+  AVFormatContext *fmt_ctx = NULL;
+  if (avformat_open_input(&fmt_ctx, index->path, NULL, NULL) < 0) {
+    fprintf(stderr, "Keyframe index: could not open '%s'\n", index->path);
+    ProfileEnd();
+    return;
+  }
+
+  for (u32 i = 0; i < fmt_ctx->nb_streams; ++i) {
+    if ((s32)i != index->stream_index) {
+      fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+    }
+  }
+
+  index->keyframes = push_array_no_zero(index->arena, Keyframe, 0);
+  index->count = 0;
+
+  AVPacket *packet = av_packet_alloc();
+  while (!index->cancel && av_read_frame(fmt_ctx, packet) >= 0) {
+    if (packet->stream_index == index->stream_index && (packet->flags & AV_PKT_FLAG_KEY)) {
+      Keyframe *keyframe = push_array_no_zero(index->arena, Keyframe, 1);
+      if (keyframe == NULL) {
+        av_packet_unref(packet);
+        break;
+      }
+      keyframe->pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+      keyframe->pos = packet->pos;
+      index->count++;
+    }
+    av_packet_unref(packet);
+  }
+  av_packet_free(&packet);
+  avformat_close_input(&fmt_ctx);
+
+  // packets come in decode order, keyframes are almost always sorted already
+  for (u64 i = 1; i < index->count; ++i) {
+    Keyframe key = index->keyframes[i];
+    u64 j = i;
+    for (; j > 0 && index->keyframes[j - 1].pts > key.pts; --j) {
+      index->keyframes[j] = index->keyframes[j - 1];
+    }
+    index->keyframes[j] = key;
+  }
+
+  ProfileEnd();
+}
+
+static void *keyframe_index_thread(void *ptr) {
+  Keyframe_Index *index = (Keyframe_Index *)ptr;
+
+  profile_thread_init();
+
+  struct stat source_stat = {0};
+  stat(index->path, &source_stat);
+
+  if (!keyframe_index_load(index, &source_stat)) {
+    arena_clear(index->arena);
+    keyframe_index_scan(index);
+    if (index->cancel) {
+      profile_thread_shutdown();
+      scratch_release_thread();
+      return NULL;
+    }
+    keyframe_index_save(index, &source_stat);
+  }
+
+  index->is_ready = true;
+
+  profile_thread_shutdown();
+
+  scratch_release_thread();
+
+  return NULL;
+}
+
+static void keyframe_index_start(Keyframe_Index *index, const char *path, s32 stream_index) {
+  ProfileFuncBegin();
+
+  snprintf(index->path, MAX_PATH_LENGTH, "%s", path);
+  index->stream_index = stream_index;
+  index->is_ready = false;
+  index->cancel = false;
+  index->count = 0;
+  index->keyframes = NULL;
+
+  // contiguous so the scan can append keyframes one by one
+  index->arena = arena_alloc((Arena_Params){
+    .name = "keyframe index",
+    .flags = ARENA_FLAG__NO_CHAIN,
+    .reserve_size = ARENA_DEFAULT_RESERVE_SIZE,
+    .commit_size = KiB(64),
+  });
+
+  pthread_create(&index->thread, NULL, keyframe_index_thread, (void *)index);
+
+  ProfileEnd();
+}
+
+static void keyframe_index_shutdown(Keyframe_Index *index) {
+  ProfileFuncBegin();
+
+  index->cancel = true;
+  pthread_join(index->thread, NULL);
+  index->is_ready = false;
+  arena_release(index->arena);
+  index->arena = NULL;
+  index->keyframes = NULL;
+  index->count = 0;
+
+  ProfileEnd();
+}
+
+// Returns the keyframe at or before pts, NULL if the index isn't ready or pts
+// comes before the first keyframe.
+static Keyframe *keyframe_index_find(Keyframe_Index *index, s64 pts) {
+  if (!index->is_ready || index->count == 0) {
+    return NULL;
+  }
+
+  u64 lo = 0;
+  u64 hi = index->count;
+  while (lo < hi) {
+    u64 mid = lo + (hi - lo) / 2;
+    if (index->keyframes[mid].pts <= pts) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  Keyframe *result = NULL;
+  if (lo > 0) {
+    result = &index->keyframes[lo - 1];
+  }
+
+  return result;
+}
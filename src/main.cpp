@@ -10,22 +10,35 @@
 
 #if PROFILE_ENABLE
 
+#include <stdlib.h>
+#include <atomic>
+
+#include "base.h"
 #include "deps/spall.h"
 
+// Every thread writes into its own buffer, the profile file is shared.
 static SpallProfile spall_ctx;
-static SpallBuffer spall_buffer;
+static thread_local SpallBuffer spall_buffer;
+static thread_local u32 spall_tid;
+static std::atomic<u32> spall_next_tid;
 
 static inline uint64_t get_micro() {
   uint64_t absolute_time = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
   return absolute_time / 10000;
 }
 
-#define ProfileFuncBegin() spall_buffer_begin(&spall_ctx, &spall_buffer, __FUNCTION__, sizeof(__FUNCTION__) - 1, get_micro())
-#define ProfileBegin(str) spall_buffer_begin(&spall_ctx, &spall_buffer, str, sizeof(str) - 1, get_micro())
-#define ProfileEnd() spall_buffer_end(&spall_ctx, &spall_buffer, get_micro())
-
-static void profile_init() {
-  spall_ctx = spall_init_file("profile.spall", 1);
+#define ProfileFuncBegin() spall_buffer_begin_ex(&spall_ctx, &spall_buffer, __FUNCTION__, sizeof(__FUNCTION__) - 1, get_micro(), spall_tid, 0)
+#define ProfileBegin(str) spall_buffer_begin_ex(&spall_ctx, &spall_buffer, str, sizeof(str) - 1, get_micro(), spall_tid, 0)
+#define ProfileEnd() spall_buffer_end_ex(&spall_ctx, &spall_buffer, get_micro(), spall_tid, 0)
+// A zero length event that carries values in its args
+#define ProfileValues(str, args, args_len) do { \
+    u64 now_ = get_micro(); \
+    spall_buffer_begin_args(&spall_ctx, &spall_buffer, str, sizeof(str) - 1, args, args_len, now_, spall_tid, 0); \
+    spall_buffer_end_ex(&spall_ctx, &spall_buffer, now_, spall_tid, 0); \
+  } while (0)
+
+static void profile_thread_init() {
+  spall_tid = spall_next_tid++;
   u64 buffer_size = MiB(1);
   spall_buffer = (SpallBuffer){
     .data = malloc(buffer_size),
@@ -34,9 +47,18 @@ static void profile_init() {
   spall_buffer_init(&spall_ctx, &spall_buffer);
 }
 
-static void profile_shutdown() {
+static void profile_thread_shutdown() {
   spall_buffer_quit(&spall_ctx, &spall_buffer);
   free(spall_buffer.data);
+}
+
+static void profile_init() {
+  spall_ctx = spall_init_file("profile.spall", 1);
+  profile_thread_init();
+}
+
+static void profile_shutdown() {
+  profile_thread_shutdown();
   spall_quit(&spall_ctx);
 }
 
@@ -47,14 +69,25 @@ static void profile_new_frame() {
 #define ProfileFuncBegin()
 #define ProfileBegin(str)
 #define ProfileEnd()
+#define ProfileValues(str, args, args_len)
 #define profile_init()
 #define profile_shutdown()
+#define profile_thread_init()
+#define profile_thread_shutdown()
 #define profile_new_frame()
 #endif
 
 #include "app.cpp"
 
-int main() {
+int main(int argc, char **argv) {
+  Export_Params export_params;
+  if (export_parse_args(argc, argv, &export_params)) {
+    profile_init();
+    s32 result = export_run(&export_params);
+    profile_shutdown();
+    return result;
+  }
+
   profile_init();
 
   glfwInit();
@@ -0,0 +1,85 @@
+struct Project_Size_Preset {
+  const char *name;
+  u32 width, height;
+};
+
+static const Project_Size_Preset project_size_presets[] = {
+  { "1080x1920 (9:16)", 1080, 1920 },
+  { "720x1280 (9:16)",   720, 1280 },
+  { "1080x1080 (1:1)",  1080, 1080 },
+  { "1920x1080 (16:9)", 1920, 1080 },
+};
+
+static const char *fit_mode_names[NUM_FIT_MODES] = {
+  "fit",
+  "fill",
+};
+
+static void project_init(Project_Settings *project) {
+  *project = {0};
+  project->width = PROJECT_DEFAULT_WIDTH;
+  project->height = PROJECT_DEFAULT_HEIGHT;
+  project->fit_mode = FIT_MODE__FIT;
+  project->playback_scale = PROJECT_DEFAULT_PLAYBACK_SCALE;
+  project->paused_scale = 1.0f;
+}
+
+// Size the preview renders at, kept even so it always matches the output aspect closely.
+static void project_preview_size(Project_Settings *project, bool is_playing, u32 *out_width, u32 *out_height) {
+  f32 scale = is_playing ? project->playback_scale : project->paused_scale;
+  *out_width = Max((u32)(project->width * scale) & ~1u, 2u);
+  *out_height = Max((u32)(project->height * scale) & ~1u, 2u);
+}
+
+static void project_scale_combo(const char *label, f32 *scale) {
+  static const f32 scales[] = { 1.0f, 0.5f, 0.25f };
+  static const char *scale_names[] = { "full", "1/2", "1/4" };
+
+  s32 selected = 0;
+  for (u32 i = 0; i < ArrayLength(scales); ++i) {
+    if (*scale == scales[i]) selected = i;
+  }
+  if (ImGui::Combo(label, &selected, scale_names, ArrayLength(scale_names))) {
+    *scale = scales[selected];
+  }
+}
+
+static void project_window(Project_Settings *project, Render_Target *target) {
+  ProfileFuncBegin();
+
+  if (ImGui::Begin("Project")) {
+    const char *current = "custom";
+    for (u32 i = 0; i < ArrayLength(project_size_presets); ++i) {
+      if (project_size_presets[i].width == project->width && project_size_presets[i].height == project->height) {
+        current = project_size_presets[i].name;
+      }
+    }
+
+    if (ImGui::BeginCombo("resolution", current)) {
+      for (u32 i = 0; i < ArrayLength(project_size_presets); ++i) {
+        const Project_Size_Preset *preset = &project_size_presets[i];
+        if (ImGui::Selectable(preset->name, preset->name == current)) {
+          project->width = preset->width;
+          project->height = preset->height;
+        }
+      }
+      ImGui::EndCombo();
+    }
+
+    s32 size[2] = { (s32)project->width, (s32)project->height };
+    if (ImGui::InputInt2("size", size, ImGuiInputTextFlags_EnterReturnsTrue)) {
+      // the encoder needs even dimensions
+      project->width = (u32)Clamp(2, size[0], 8192) & ~1u;
+      project->height = (u32)Clamp(2, size[1], 8192) & ~1u;
+    }
+
+    ImGui::Combo("fit", (s32 *)&project->fit_mode, fit_mode_names, NUM_FIT_MODES);
+    project_scale_combo("preview while playing", &project->playback_scale);
+    project_scale_combo("preview when paused", &project->paused_scale);
+
+    ImGui::Text("preview: %u x %u", target->width, target->height);
+  }
+  ImGui::End();
+
+  ProfileEnd();
+}
@@ -0,0 +1,212 @@
+#include <sys/stat.h>
+
+static void proxy_path(const char *source_path, char *out, u32 out_size) {
+  snprintf(out, out_size, "%s.proxy.mov", source_path);
+}
+
+static bool proxy_is_current(const char *source_path) {
+  char path[MAX_PATH_LENGTH + 16];
+  proxy_path(source_path, path, sizeof(path));
+
+  struct stat source_stat, proxy_stat;
+  return stat(source_path, &source_stat) == 0 &&
+         stat(path, &proxy_stat) == 0 &&
+         proxy_stat.st_mtime >= source_stat.st_mtime;
+}
+
+// Decodes every frame of the source and encodes it scaled down to at most
+// PROXY_MAX_HEIGHT, keeping the source's timestamps so the proxy maps 1:1.
+static bool proxy_generate(Proxy_Generator *gen, const char *source_path) {
+  ProfileFuncBegin();
+
+  char path[MAX_PATH_LENGTH + 16];
+  char partial_path[MAX_PATH_LENGTH + 32];
+  proxy_path(source_path, path, sizeof(path));
+  // written under another name first, the preview never opens a half written proxy
+  snprintf(partial_path, sizeof(partial_path), "%s.partial.mov", path);
+
+  bool result = false;
+  Video video = {0};
+  if (video_open(&video, source_path, VIDEO_OPEN_FLAG__FULL_QUALITY | VIDEO_OPEN_FLAG__NO_KEYFRAME_INDEX)) {
+    u32 height = Min((u32)video.height, (u32)PROXY_MAX_HEIGHT) & ~1u;
+    u32 width = ((u32)((u64)video.width * height / Max(video.height, 1)) + 1) & ~1u;
+
+    Encoder_Params params = {
+      .preset = ENCODER_PRESET__PROXY,
+      .width = width,
+      .height = height,
+      .frame_rate = video.frame_rate.num > 0 ? video.frame_rate : (AVRational){30, 1},
+      .time_base = video.time_base,
+    };
+
+    Encoder encoder;
+    if (encoder_open(&encoder, partial_path, &params)) {
+      f64 duration = video_duration(&video);
+      s64 last_pts = INT64_MIN;
+
+      while (!gen->cancel && video_decode_next(&video)) {
+        AVFrame *frame = video.frame;
+
+        // the muxer needs strictly increasing timestamps
+        s64 pts = frame->best_effort_timestamp;
+        pts = pts != AV_NOPTS_VALUE ? pts - video.start_pts : last_pts + 1;
+        if (pts <= last_pts) pts = last_pts + 1;
+        last_pts = pts;
+
+        encoder_write_frame(&encoder, frame->data, frame->linesize, (AVPixelFormat)frame->format,
+                            frame->width, frame->height, pts);
+
+        if (duration > 0.0) {
+          gen->progress = (f32)Clamp(0.0, pts_to_sec(video.time_base, pts) / duration, 1.0);
+        }
+      }
+
+      result = !gen->cancel && encoder.frame_index > 0;
+      encoder_close(&encoder);
+    }
+
+    video_close(&video);
+  }
+
+  if (result) {
+    result = rename(partial_path, path) == 0;
+  }
+  if (!result) {
+    remove(partial_path);
+  }
+
+  ProfileEnd();
+
+  return result;
+}
+
+static void *proxy_generator_thread(void *ptr) {
+  Proxy_Generator *gen = (Proxy_Generator *)ptr;
+
+  profile_thread_init();
+
+  pthread_mutex_lock(&gen->mutex);
+  while (gen->is_running) {
+    if (gen->next_job == gen->num_jobs) {
+      pthread_cond_wait(&gen->cond, &gen->mutex);
+      continue;
+    }
+
+    char source_path[MAX_PATH_LENGTH];
+    memcpy(source_path, gen->jobs[gen->next_job], MAX_PATH_LENGTH);
+    gen->next_job++;
+    pthread_mutex_unlock(&gen->mutex);
+
+    if (!proxy_is_current(source_path)) {
+      gen->progress = 0.0f;
+      if (proxy_generate(gen, source_path)) {
+        gen->num_done++;
+      } else if (!gen->cancel) {
+        fprintf(stderr, "Proxy: could not transcode '%s'\n", source_path);
+        gen->num_failed++;
+      }
+    }
+
+    pthread_mutex_lock(&gen->mutex);
+  }
+  pthread_mutex_unlock(&gen->mutex);
+
+  profile_thread_shutdown();
+
+  scratch_release_thread();
+
+  return NULL;
+}
+
+static void proxy_generator_init(Proxy_Generator *gen) {
+  ProfileFuncBegin();
+
+  gen->mutex = PTHREAD_MUTEX_INITIALIZER;
+  gen->cond = PTHREAD_COND_INITIALIZER;
+  gen->is_running = true;
+  gen->cancel = false;
+
+  pthread_create(&gen->thread, NULL, proxy_generator_thread, (void *)gen);
+
+  ProfileEnd();
+}
+
+static void proxy_generator_shutdown(Proxy_Generator *gen) {
+  ProfileFuncBegin();
+
+  pthread_mutex_lock(&gen->mutex);
+  gen->is_running = false;
+  gen->cancel = true;
+  pthread_cond_signal(&gen->cond);
+  pthread_mutex_unlock(&gen->mutex);
+
+  pthread_join(gen->thread, NULL);
+
+  ProfileEnd();
+}
+
+// Queues a proxy for every video the lister found. Sources that already have
+// a current proxy are skipped by the generator thread.
+static void proxy_generator_enqueue_sources(Proxy_Generator *gen, Video_Lister *lister) {
+  ProfileFuncBegin();
+
+  pthread_mutex_lock(&gen->mutex);
+
+  // restart the queue once everything queued before has been handled
+  if (gen->next_job == gen->num_jobs) {
+    gen->next_job = 0;
+    gen->num_jobs = 0;
+  }
+
+  for (u32 i = 0; i < lister->num_sources && gen->num_jobs < PROXY_MAX_JOBS; ++i) {
+    const char *path = lister->sources[i].video_file;
+    if (path[0] == 0) continue;
+
+    bool is_queued = false;
+    for (u32 j = gen->next_job; j < gen->num_jobs && !is_queued; ++j) {
+      is_queued = strcmp(gen->jobs[j], path) == 0;
+    }
+    if (!is_queued) {
+      snprintf(gen->jobs[gen->num_jobs++], MAX_PATH_LENGTH, "%s", path);
+    }
+  }
+
+  pthread_cond_signal(&gen->cond);
+  pthread_mutex_unlock(&gen->mutex);
+
+  ProfileEnd();
+}
+
+static void proxy_refresh_timeline(Timeline *tl) {
+  ProfileFuncBegin();
+
+  for (u32 i = 0; i < tl->num_sources; ++i) {
+    Timeline_Source *source = &tl->sources[i];
+    proxy_path(source->path, source->proxy_path, MAX_PATH_LENGTH);
+    source->has_proxy = proxy_is_current(source->path);
+  }
+
+  ProfileEnd();
+}
+
+static void proxy_generator_window(Proxy_Generator *gen, Video_Lister *lister, bool *use_proxies) {
+  ProfileFuncBegin();
+
+  if (ImGui::Begin("Proxies")) {
+    ImGui::Checkbox("use proxies for preview", use_proxies);
+
+    if (ImGui::Button("Generate proxies")) {
+      proxy_generator_enqueue_sources(gen, lister);
+    }
+
+    pthread_mutex_lock(&gen->mutex);
+    u32 remaining = gen->num_jobs - gen->next_job;
+    pthread_mutex_unlock(&gen->mutex);
+
+    ImGui::Text("queued: %u, written: %u, failed: %u", remaining, gen->num_done.load(), gen->num_failed.load());
+    ImGui::ProgressBar(gen->progress);
+  }
+  ImGui::End();
+
+  ProfileEnd();
+}
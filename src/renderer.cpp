@@ -2,50 +2,281 @@
 const char *vertex_shader_source = R"(
   #version 330 core
 
-  layout (location = 0) in vec3 a_pos;
+  layout (location = 0) in vec2 a_pos;
   layout (location = 1) in vec2 a_uv;
+  layout (location = 2) in float a_opacity;
 
   out vec2 pass_uv;
+  out float pass_opacity;
 
   void main() {
     pass_uv = a_uv;
-    gl_Position = vec4(a_pos, 1.0f);
+    pass_opacity = a_opacity;
+    gl_Position = vec4(a_pos, 0.0f, 1.0f);
   }
 )";
 
-const char *fragment_shader_source = R"(
+const char *yuv_fragment_shader_source = R"(
   #version 330 core
 
   in vec2 pass_uv;
+  in float pass_opacity;
   out vec4 frag_color;
 
   uniform vec3 draw_color;
 
-  uniform sampler2D y_tex;
-  uniform sampler2D u_tex;
+  uniform sampler2D y_tex; // holds the RGB frame when is_rgb
+  uniform sampler2D u_tex; // holds U and V when is_interleaved
   uniform sampler2D v_tex;
 
+  uniform bool is_rgb; // the frame went through its effects and is converted already
+
+  uniform bool is_interleaved;
+  uniform float sample_scale;
+  uniform mat3 yuv_to_rgb;
+  uniform vec3 yuv_offset;
+  uniform int transfer; // Color_Transfer
+
+  const int TRANSFER_LINEAR = 1;
+  const int TRANSFER_PQ = 2;
+  const int TRANSFER_HLG = 3;
+
+  // HDR is mapped to display light relative to SDR reference white (203 nits)
+  vec3 pq_to_linear(vec3 e) {
+    const float m1 = 0.1593017578125;
+    const float m2 = 78.84375;
+    const float c1 = 0.8359375;
+    const float c2 = 18.8515625;
+    const float c3 = 18.6875;
+    vec3 p = pow(max(e, 0.0), vec3(1.0 / m2));
+    vec3 nits = 10000.0 * pow(max(p - c1, 0.0) / (c2 - c3 * p), vec3(1.0 / m1));
+    return nits / 203.0;
+  }
+
+  vec3 hlg_to_linear(vec3 e) {
+    const float a = 0.17883277;
+    const float b = 0.28466892;
+    const float c = 0.55991073;
+    vec3 scene = mix(e * e / 3.0, (exp((e - c) / a) + b) / 12.0, step(0.5, e));
+    // 1000 nit display, the OOTF puts reference white at 203 nits
+    return pow(scene, vec3(1.2)) * (1000.0 / 203.0);
+  }
+
+  // keeps everything below the knee and rolls the highlights off towards 1
+  vec3 tone_map(vec3 x) {
+    const float knee = 0.8;
+    vec3 over = max(x - knee, 0.0);
+    return min(x, knee) + (1.0 - knee) * (1.0 - exp(-over / (1.0 - knee)));
+  }
+
+  vec3 to_display(vec3 rgb) {
+    if (transfer == TRANSFER_PQ || transfer == TRANSFER_HLG) {
+      vec3 linear = transfer == TRANSFER_PQ ? pq_to_linear(rgb) : hlg_to_linear(rgb);
+      // both come with BT.2020 primaries
+      const mat3 bt2020_to_bt709 = mat3(
+         1.6605, -0.1246, -0.0182,
+        -0.5876,  1.1329, -0.1006,
+        -0.0728, -0.0083,  1.1187);
+      linear = tone_map(max(bt2020_to_bt709 * linear, 0.0));
+      rgb = pow(linear, vec3(1.0 / 2.4));
+    } else if (transfer == TRANSFER_LINEAR) {
+      rgb = pow(max(rgb, 0.0), vec3(1.0 / 2.4));
+    }
+    return rgb;
+  }
+
   void main() {
-    float y = texture(y_tex, pass_uv).r;
-    float u = texture(u_tex, pass_uv).r - 0.5;
-    float v = texture(v_tex, pass_uv).r - 0.5;
+    if (is_rgb) {
+      frag_color = vec4(texture(y_tex, pass_uv).rgb * draw_color, pass_opacity);
+      return;
+    }
+
+    vec3 yuv;
+    yuv.x = texture(y_tex, pass_uv).r;
+    if (is_interleaved) {
+      yuv.yz = texture(u_tex, pass_uv).rg;
+    } else {
+      yuv.y = texture(u_tex, pass_uv).r;
+      yuv.z = texture(v_tex, pass_uv).r;
+    }
+
+    vec3 rgb = yuv_to_rgb * (yuv * sample_scale - yuv_offset);
+    rgb = to_display(clamp(rgb, 0.0, 1.0));
+
+    frag_color = vec4(clamp(rgb, 0.0, 1.0) * draw_color, pass_opacity);
+  }
+)";
+
+// One effect pass: an optional neighbourhood kernel, then the fused per pixel
+// effects. The input is the RGB frame, the output goes to the next target.
+const char *effect_fragment_shader_source = R"(
+  #version 330 core
+
+  in vec2 pass_uv;
+  in float pass_opacity;
+  out vec4 frag_color;
 
-    float r = y + 1.402 * v;
-    float g = y - 0.344 * u - 0.714 * v;
-    float b = y + 1.772 * u;
+  uniform sampler2D source;
+  uniform sampler3D lut;
+
+  uniform int kernel; // Effect_Kernel
+  uniform vec2 texel_size;
+  uniform float strength; // blur radius in texels, or sharpen amount
+
+  uniform bool has_color;
+  uniform vec4 color_params; // exposure in stops, contrast, saturation, temperature
+  uniform bool has_lut;
+  uniform float lut_size;
+  uniform float lut_mix;
+
+  const int KERNEL_BLUR_X = 1;
+  const int KERNEL_BLUR_Y = 2;
+  const int KERNEL_SHARPEN = 3;
+  const int BLUR_MAX_TAPS = 32; // a side, wider blurs spread their taps out
+
+  vec3 blur(vec2 direction) {
+    float radius = max(strength, 0.5);
+    float sigma = radius / 3.0;
+    int taps = int(min(ceil(radius), float(BLUR_MAX_TAPS)));
+    float spacing = radius / float(taps);
+
+    vec3 sum = texture(source, pass_uv).rgb;
+    float total = 1.0;
+    for (int i = 1; i <= taps; ++i) {
+      float x = float(i) * spacing;
+      float weight = exp(-0.5 * x * x / (sigma * sigma));
+      vec2 offset = direction * texel_size * x;
+      sum += weight * (texture(source, pass_uv + offset).rgb + texture(source, pass_uv - offset).rgb);
+      total += 2.0 * weight;
+    }
+    return sum / total;
+  }
+
+  vec3 sharpen() {
+    vec3 center = texture(source, pass_uv).rgb;
+    vec3 around = texture(source, pass_uv + vec2(texel_size.x, 0.0)).rgb +
+                  texture(source, pass_uv - vec2(texel_size.x, 0.0)).rgb +
+                  texture(source, pass_uv + vec2(0.0, texel_size.y)).rgb +
+                  texture(source, pass_uv - vec2(0.0, texel_size.y)).rgb;
+    return center + strength * (4.0 * center - around);
+  }
+
+  vec3 color_correct(vec3 rgb) {
+    rgb *= exp2(color_params.x);
+    rgb = (rgb - 0.5) * color_params.y + 0.5;
+    float luma = dot(rgb, vec3(0.2126, 0.7152, 0.0722));
+    rgb = mix(vec3(luma), rgb, color_params.z);
+    rgb *= vec3(1.0 + color_params.w, 1.0, 1.0 - color_params.w);
+    return clamp(rgb, 0.0, 1.0);
+  }
 
-    frag_color = vec4(vec3(r, g, b) * draw_color, 1.0);
+  void main() {
+    vec3 rgb;
+    if (kernel == KERNEL_BLUR_X) {
+      rgb = blur(vec2(1.0, 0.0));
+    } else if (kernel == KERNEL_BLUR_Y) {
+      rgb = blur(vec2(0.0, 1.0));
+    } else if (kernel == KERNEL_SHARPEN) {
+      rgb = sharpen();
+    } else {
+      rgb = texture(source, pass_uv).rgb;
+    }
+    rgb = clamp(rgb, 0.0, 1.0);
+
+    if (has_color) {
+      rgb = color_correct(rgb);
+    }
+    if (has_lut) {
+      // 0 and 1 land on the centers of the outer texels
+      vec3 coord = rgb * ((lut_size - 1.0) / lut_size) + 0.5 / lut_size;
+      rgb = mix(rgb, texture(lut, coord).rgb, lut_mix);
+    }
+
+    frag_color = vec4(rgb, 1.0);
   }
 )";
 
-static u32 create_shader_program() {
+// num_planes, bytes_per_sample, chroma_channels, bit_depth, sample_scale
+static const Pixel_Layout_Info pixel_layout_infos[NUM_PIXEL_LAYOUTS] = {
+  { 3, 1, 1, 8,  1.0f },               // YUV420P
+  { 3, 2, 1, 10, 65535.0f / 1023.0f }, // YUV420P10
+  { 2, 1, 2, 8,  1.0f },               // NV12
+  { 2, 2, 2, 10, 65535.0f / 65472.0f }, // P010
+};
+
+// Kr and Kb of each matrix, Kg = 1 - Kr - Kb
+static const f32 color_matrix_coefficients[NUM_COLOR_MATRICES][2] = {
+  { 0.299f,  0.114f },  // BT.601
+  { 0.2126f, 0.0722f }, // BT.709
+  { 0.2627f, 0.0593f }, // BT.2020
+};
+
+static const char *color_matrix_names[NUM_COLOR_MATRICES] = {
+  "BT.601",
+  "BT.709",
+  "BT.2020",
+};
+
+static const char *color_transfer_names[NUM_COLOR_TRANSFERS] = {
+  "SDR",
+  "linear",
+  "PQ",
+  "HLG",
+};
+
+// Chroma planes have half the width and height, rounded up so odd sizes keep
+// their last column and row.
+static inline u32 chroma_size(u32 size) {
+  return (size + 1) / 2;
+}
+
+static inline u64 yuv_frame_bytes(u32 width, u32 height, Pixel_Layout layout) {
+  u64 samples = (u64)width * height + 2 * (u64)chroma_size(width) * chroma_size(height);
+  return samples * pixel_layout_infos[layout].bytes_per_sample;
+}
+
+// Builds the column major matrix and the offset for rgb = matrix * (yuv - offset),
+// with yuv normalized to [0, 1] at the layout's bit depth.
+static void yuv_to_rgb_matrix(Video_Color color, u32 bit_depth, f32 *out_matrix, f32 *out_offset) {
+  f32 kr = color_matrix_coefficients[color.matrix][0];
+  f32 kb = color_matrix_coefficients[color.matrix][1];
+  f32 kg = 1.0f - kr - kb;
+
+  f32 max_value = (f32)((1 << bit_depth) - 1);
+  f32 chroma_zero = (f32)(1 << (bit_depth - 1)) / max_value;
+
+  // limited range puts black at 16 and white at 235 (240 for chroma), scaled up to the bit depth
+  f32 y_scale = 1.0f;
+  f32 c_scale = 1.0f;
+  out_offset[0] = 0.0f;
+  if (!color.is_full_range) {
+    f32 step = (f32)(1 << (bit_depth - 8));
+    y_scale = max_value / (219.0f * step);
+    c_scale = max_value / (224.0f * step);
+    out_offset[0] = 16.0f * step / max_value;
+  }
+  out_offset[1] = chroma_zero;
+  out_offset[2] = chroma_zero;
+
+  f32 matrix[9] = {
+    // column for Y
+    y_scale, y_scale, y_scale,
+    // column for U
+    0.0f, -2.0f * kb * (1.0f - kb) / kg * c_scale, 2.0f * (1.0f - kb) * c_scale,
+    // column for V
+    2.0f * (1.0f - kr) * c_scale, -2.0f * kr * (1.0f - kr) / kg * c_scale, 0.0f,
+  };
+  memcpy(out_matrix, matrix, sizeof(matrix));
+}
+
+static u32 create_shader_program(const char *vertex_source, const char *fragment_source) {
   ProfileFuncBegin();
 
   s32 success;
   char info_log[512];
 
   u32 vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vertex_shader, 1, &vertex_shader_source, NULL);
+  glShaderSource(vertex_shader, 1, &vertex_source, NULL);
   glCompileShader(vertex_shader);
   glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
   if (!success) {
@@ -54,7 +285,7 @@ static u32 create_shader_program() {
   }
 
   u32 fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fragment_shader, 1, &fragment_shader_source, NULL);
+  glShaderSource(fragment_shader, 1, &fragment_source, NULL);
   glCompileShader(fragment_shader);
   glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
   if (!success) {
@@ -82,57 +313,255 @@ static u32 create_shader_program() {
   return shader_program;
 }
 
-static YUV_Texture create_yuv_texture(u32 width, u32 height) {
+static YUV_Shader create_yuv_shader() {
   ProfileFuncBegin();
 
-  u32 textures[3];
-  glGenTextures(3, textures);
+  YUV_Shader result = {0};
+  result.program = create_shader_program(vertex_shader_source, yuv_fragment_shader_source);
 
-  glBindTexture(GL_TEXTURE_2D, textures[0]);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  // samplers never change, the rest is set per draw through the cached locations
+  glUniform1i(glGetUniformLocation(result.program, "y_tex"), 0);
+  glUniform1i(glGetUniformLocation(result.program, "u_tex"), 1);
+  glUniform1i(glGetUniformLocation(result.program, "v_tex"), 2);
 
-  glBindTexture(GL_TEXTURE_2D, textures[1]);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width / 2, height / 2, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  result.draw_color = glGetUniformLocation(result.program, "draw_color");
+  result.is_interleaved = glGetUniformLocation(result.program, "is_interleaved");
+  result.sample_scale = glGetUniformLocation(result.program, "sample_scale");
+  result.yuv_to_rgb = glGetUniformLocation(result.program, "yuv_to_rgb");
+  result.yuv_offset = glGetUniformLocation(result.program, "yuv_offset");
+  result.transfer = glGetUniformLocation(result.program, "transfer");
+  result.is_rgb = glGetUniformLocation(result.program, "is_rgb");
 
-  glBindTexture(GL_TEXTURE_2D, textures[2]);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width / 2, height / 2, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  ProfileEnd();
+
+  return result;
+}
+
+// Texture format of one plane: 8 bit samples are R8/RG8, 16 bit ones R16/RG16.
+static void yuv_plane_format(Pixel_Layout layout, u32 plane, s32 *internal_format, u32 *format, u32 *type) {
+  const Pixel_Layout_Info *info = &pixel_layout_infos[layout];
+  bool is_two_channel = plane > 0 && info->chroma_channels == 2;
+  bool is_16_bit = info->bytes_per_sample == 2;
+
+  if (is_two_channel) {
+    *internal_format = is_16_bit ? GL_RG16 : GL_RG8;
+    *format = GL_RG;
+  } else {
+    *internal_format = is_16_bit ? GL_R16 : GL_R8;
+    *format = GL_RED;
+  }
+  *type = is_16_bit ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+}
+
+static YUV_Texture create_yuv_texture(u32 width, u32 height, Pixel_Layout layout) {
+  ProfileFuncBegin();
+
+  u32 num_planes = pixel_layout_infos[layout].num_planes;
+  u32 textures[3] = {0};
+  glGenTextures(num_planes, textures);
+
+  for (u32 i = 0; i < num_planes; ++i) {
+    s32 internal_format;
+    u32 format, type;
+    yuv_plane_format(layout, i, &internal_format, &format, &type);
+
+    u32 plane_width = i == 0 ? width : chroma_size(width);
+    u32 plane_height = i == 0 ? height : chroma_size(height);
+
+    glBindTexture(GL_TEXTURE_2D, textures[i]);
+    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, plane_width, plane_height, 0, format, type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  }
 
   YUV_Texture result = {
     .width = width,
     .height = height,
+    .layout = layout,
   };
   memcpy(result.ids, textures, sizeof(textures));
 
+  glBindTexture(GL_TEXTURE_2D, 0);
+
   ProfileEnd();
 
   return result;
 }
 
-static void upload_frame_to_texture(YUV_Texture texture, Video_Frame_YUV frame) {
+static void destroy_yuv_texture(YUV_Texture *texture) {
   ProfileFuncBegin();
 
-  u32 *textures = texture.ids;
+  glDeleteTextures(pixel_layout_infos[texture->layout].num_planes, texture->ids);
+  *texture = {0};
 
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, textures[0]);
-  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame.width, frame.height,
-                  GL_RED, GL_UNSIGNED_BYTE, frame.y_data);
+  ProfileEnd();
+}
 
-  glActiveTexture(GL_TEXTURE1);
-  glBindTexture(GL_TEXTURE_2D, textures[1]);
-  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame.width / 2, frame.height / 2,
-                  GL_RED, GL_UNSIGNED_BYTE, frame.u_data);
+static void upload_frame_to_texture(Renderer *r, YUV_Texture *texture, Video_Frame_YUV frame) {
+  ProfileFuncBegin();
 
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, textures[2]);
-  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame.width / 2, frame.height / 2,
-                  GL_RED, GL_UNSIGNED_BYTE, frame.v_data);
+  Upload_Ring *ring = &r->upload_ring;
+  u32 *textures = texture->ids;
+  u32 *pbos = ring->pbos[ring->index];
+  u64 *pbo_sizes = ring->sizes[ring->index];
+  ring->index = (ring->index + 1) % UPLOAD_RING_SIZE;
+
+  const Pixel_Layout_Info *info = &pixel_layout_infos[frame.layout];
+  texture->color = frame.color;
+
+  u8 *planes[3] = { frame.y_data, frame.u_data, frame.v_data };
+  u32 strides[3] = { frame.y_stride, frame.uv_stride, frame.uv_stride };
+  u32 widths[3] = { frame.width, chroma_size(frame.width), chroma_size(frame.width) };
+  u32 heights[3] = { frame.height, chroma_size(frame.height), chroma_size(frame.height) };
+
+  // strides can be padded (frames straight from the decoder) or odd (half width chroma)
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  for (u32 i = 0; i < info->num_planes; ++i) {
+    u64 size = (u64)strides[i] * heights[i];
+
+    s32 internal_format;
+    u32 format, type;
+    yuv_plane_format(frame.layout, i, &internal_format, &format, &type);
+    u32 bytes_per_texel = info->bytes_per_sample * (i > 0 ? info->chroma_channels : 1);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[i]);
+    if (pbo_sizes[i] < size) {
+      glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+      pbo_sizes[i] = size;
+    }
+
+    // invalidating lets the driver hand us fresh memory instead of syncing
+    ProfileBegin("pbo map");
+    void *dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    ProfileEnd();
+
+    if (dst) {
+      ProfileBegin("pbo copy");
+      memcpy(dst, planes[i], size);
+      ProfileEnd();
+
+      ProfileBegin("pbo unmap");
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+      ProfileEnd();
+
+      // the transfer from the pbo happens asynchronously
+      glBindTexture(GL_TEXTURE_2D, textures[i]);
+      glPixelStorei(GL_UNPACK_ROW_LENGTH, strides[i] / bytes_per_texel);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, widths[i], heights[i],
+                      format, type, (void *)0);
+    }
+  }
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  ProfileEnd();
+}
+
+static void readback_ring_init(Readback_Ring *ring, u32 width, u32 height) {
+  ProfileFuncBegin();
+
+  *ring = {0};
+  ring->width = width;
+  ring->height = height;
+
+  glGenBuffers(READBACK_RING_SIZE, ring->pbos);
+  for (u32 i = 0; i < READBACK_RING_SIZE; ++i) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, ring->pbos[i]);
+    glBufferData(GL_PIXEL_PACK_BUFFER, (u64)width * height * 4, NULL, GL_STREAM_READ);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  ProfileEnd();
+}
+
+static void readback_ring_shutdown(Readback_Ring *ring) {
+  ProfileFuncBegin();
+
+  for (u32 i = 0; i < READBACK_RING_SIZE; ++i) {
+    if (ring->fences[i]) glDeleteSync(ring->fences[i]);
+  }
+  glDeleteBuffers(READBACK_RING_SIZE, ring->pbos);
+  *ring = {0};
+
+  ProfileEnd();
+}
+
+static inline u32 readback_ring_count(Readback_Ring *ring) {
+  return ring->write_index - ring->read_index;
+}
+
+// Starts an asynchronous RGBA readback of the target. The target must be the
+// ring's size. Returns false if all buffers are still waiting to be read.
+static bool readback_ring_push(Readback_Ring *ring, Render_Target *target) {
+  ProfileFuncBegin();
+
+  bool result = false;
+  if (readback_ring_count(ring) < READBACK_RING_SIZE) {
+    u32 slot = ring->write_index % READBACK_RING_SIZE;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target->fbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, ring->pbos[slot]);
+    glReadPixels(0, 0, ring->width, ring->height, GL_RGBA, GL_UNSIGNED_BYTE, (void *)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    ring->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ring->write_index++;
+    result = true;
+  }
+
+  ProfileEnd();
+
+  return result;
+}
+
+// Maps the oldest readback, the first row is the top of the image. Without wait, returns NULL if
+// the GPU isn't done with it yet. Every non-NULL map needs a readback_ring_unmap.
+static u8 *readback_ring_map(Readback_Ring *ring, bool wait) {
+  ProfileFuncBegin();
+
+  u8 *result = NULL;
+  if (readback_ring_count(ring) > 0) {
+    u32 slot = ring->read_index % READBACK_RING_SIZE;
+
+    GLenum status = glClientWaitSync(ring->fences[slot], 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED && wait) {
+      ProfileBegin("readback stall");
+      ring->stalls++;
+      do {
+        status = glClientWaitSync(ring->fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+      } while (status == GL_TIMEOUT_EXPIRED);
+      ProfileEnd();
+    }
+
+    if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, ring->pbos[slot]);
+      result = (u8 *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (u64)ring->width * ring->height * 4,
+                                      GL_MAP_READ_BIT);
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+  }
+
+  ProfileEnd();
+
+  return result;
+}
+
+static void readback_ring_unmap(Readback_Ring *ring) {
+  ProfileFuncBegin();
+
+  u32 slot = ring->read_index % READBACK_RING_SIZE;
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, ring->pbos[slot]);
+  glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  glDeleteSync(ring->fences[slot]);
+  ring->fences[slot] = NULL;
+  ring->read_index++;
 
   ProfileEnd();
 }
@@ -166,55 +595,504 @@ static Render_Target create_render_target(u32 width, u32 height) {
   };
 }
 
-static void renderer_init(Renderer *r) {
+static void destroy_render_target(Render_Target *target) {
+  ProfileFuncBegin();
+
+  glDeleteFramebuffers(1, &target->fbo);
+  glDeleteTextures(1, &target->tex);
+  *target = {0};
+
+  ProfileEnd();
+}
+
+static const char *effect_type_names[NUM_EFFECT_TYPES] = {
+  "color",   // EFFECT_TYPE__COLOR
+  "blur",    // EFFECT_TYPE__BLUR
+  "sharpen", // EFFECT_TYPE__SHARPEN
+  "lut",     // EFFECT_TYPE__LUT
+};
+
+static const f32 effect_default_params[NUM_EFFECT_TYPES][4] = {
+  { 0.0f, 1.0f, 1.0f, 0.0f }, // EFFECT_TYPE__COLOR
+  { 0.01f },                  // EFFECT_TYPE__BLUR
+  { 0.5f },                   // EFFECT_TYPE__SHARPEN
+  { 1.0f },                   // EFFECT_TYPE__LUT
+};
+
+static Effect_Shader create_effect_shader() {
+  ProfileFuncBegin();
+
+  Effect_Shader result = {0};
+  result.program = create_shader_program(vertex_shader_source, effect_fragment_shader_source);
+
+  glUniform1i(glGetUniformLocation(result.program, "source"), 0);
+  glUniform1i(glGetUniformLocation(result.program, "lut"), 3);
+
+  result.kernel = glGetUniformLocation(result.program, "kernel");
+  result.texel_size = glGetUniformLocation(result.program, "texel_size");
+  result.strength = glGetUniformLocation(result.program, "strength");
+  result.has_color = glGetUniformLocation(result.program, "has_color");
+  result.color_params = glGetUniformLocation(result.program, "color_params");
+  result.has_lut = glGetUniformLocation(result.program, "has_lut");
+  result.lut_size = glGetUniformLocation(result.program, "lut_size");
+  result.lut_mix = glGetUniformLocation(result.program, "lut_mix");
+
+  ProfileEnd();
+
+  return result;
+}
+
+static void yuv_shader_set_color(YUV_Shader *shader, Pixel_Layout layout, Video_Color color) {
+  const Pixel_Layout_Info *info = &pixel_layout_infos[layout];
+  f32 matrix[9], offset[3];
+  yuv_to_rgb_matrix(color, info->bit_depth, matrix, offset);
+
+  glUniform1i(shader->is_interleaved, info->chroma_channels == 2);
+  glUniform1f(shader->sample_scale, info->sample_scale);
+  glUniformMatrix3fv(shader->yuv_to_rgb, 1, GL_FALSE, matrix);
+  glUniform3fv(shader->yuv_offset, 1, offset);
+  glUniform1i(shader->transfer, color.transfer);
+}
+
+// Borrows a target of exactly width x height until render_target_pool_release.
+// Targets of other sizes that are free get replaced when the pool is full.
+// Returns -1 when every target is borrowed.
+static s32 render_target_pool_acquire(Render_Target_Pool *pool, u32 width, u32 height) {
+  s32 result = -1;
+  s32 empty = -1;
+  s32 other_size = -1;
+  for (u32 i = 0; i < RENDER_TARGET_POOL_SIZE; ++i) {
+    Render_Target *target = &pool->targets[i];
+    if (pool->in_use[i]) continue;
+
+    if (target->fbo == 0) {
+      if (empty < 0) empty = (s32)i;
+    } else if (target->width == width && target->height == height) {
+      result = (s32)i;
+      break;
+    } else if (other_size < 0) {
+      other_size = (s32)i;
+    }
+  }
+
+  if (result < 0) {
+    result = empty >= 0 ? empty : other_size;
+    if (result >= 0) {
+      Render_Target *target = &pool->targets[result];
+      if (target->fbo) destroy_render_target(target);
+      *target = create_render_target(width, height);
+      pool->created++;
+    }
+  }
+
+  if (result >= 0) pool->in_use[result] = true;
+
+  return result;
+}
+
+static void render_target_pool_release(Render_Target_Pool *pool, s32 index) {
+  if (index >= 0) pool->in_use[index] = false;
+}
+
+static void render_target_pool_shutdown(Render_Target_Pool *pool) {
+  for (u32 i = 0; i < RENDER_TARGET_POOL_SIZE; ++i) {
+    if (pool->targets[i].fbo) destroy_render_target(&pool->targets[i]);
+  }
+  *pool = {0};
+}
+
+// Uploads size^3 RGB entries, red changing fastest as in .cube files.
+// Returns the LUT's index, or -1 when there is no room for it.
+static s32 renderer_add_lut(Renderer *r, const char *name, u32 size, const f32 *rgb) {
+  ProfileFuncBegin();
+
+  s32 result = -1;
+  if (r->num_luts < EFFECT_MAX_LUTS) {
+    Effect_Lut *lut = &r->luts[r->num_luts];
+    snprintf(lut->name, sizeof(lut->name), "%s", name);
+    lut->size = size;
+
+    glGenTextures(1, &lut->texture);
+    glBindTexture(GL_TEXTURE_3D, lut->texture);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB16F, size, size, size, 0, GL_RGB, GL_FLOAT, rgb);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+    result = (s32)r->num_luts++;
+  } else {
+    fprintf(stderr, "Renderer: no more than %d LUTs\n", EFFECT_MAX_LUTS);
+  }
+
+  ProfileEnd();
+
+  return result;
+}
+
+// Loads a 3D LUT in the .cube format. Returns its index or -1.
+static s32 renderer_load_lut(Renderer *r, const char *path) {
+  ProfileFuncBegin();
+
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    fprintf(stderr, "Renderer: could not open LUT '%s'\n", path);
+    ProfileEnd();
+    return -1;
+  }
+
+  Temp scratch = scratch_begin(NULL, 0);
+
+  s32 result = -1;
+  u32 size = 0;
+  u32 count = 0;
+  f32 *rgb = NULL;
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    f32 r_value, g_value, b_value;
+    if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') {
+      continue;
+    } else if (sscanf(line, "LUT_3D_SIZE %u", &size) == 1) {
+      if (size < 2 || size > 128 || rgb) break;
+      rgb = push_array_no_zero(scratch.arena, f32, (u64)size * size * size * 3);
+    } else if (sscanf(line, "%f %f %f", &r_value, &g_value, &b_value) == 3) {
+      if (rgb == NULL || count == size * size * size) break;
+      rgb[count * 3 + 0] = r_value;
+      rgb[count * 3 + 1] = g_value;
+      rgb[count * 3 + 2] = b_value;
+      count++;
+    }
+    // TITLE, DOMAIN_MIN and DOMAIN_MAX are ignored, the domain is taken as 0..1
+  }
+  fclose(file);
+
+  if (rgb && count == size * size * size) {
+    const char *name = strrchr(path, '/');
+    result = renderer_add_lut(r, name ? name + 1 : path, size, rgb);
+  } else {
+    fprintf(stderr, "Renderer: '%s' is not a 3D .cube LUT\n", path);
+  }
+
+  scratch_end(scratch);
+
+  ProfileEnd();
+
+  return result;
+}
+
+// A built in look so the LUT effect works without any files: a soft S-curve
+// with cool shadows and warm highlights.
+static void renderer_add_film_lut(Renderer *r) {
+  const u32 size = 17;
+  static f32 rgb[size * size * size * 3];
+
+  for (u32 b = 0; b < size; ++b) {
+    for (u32 g = 0; g < size; ++g) {
+      for (u32 i = 0; i < size; ++i) {
+        f32 in[3] = { i / (f32)(size - 1), g / (f32)(size - 1), b / (f32)(size - 1) };
+        f32 luma = 0.2126f * in[0] + 0.7152f * in[1] + 0.0722f * in[2];
+        f32 shadows[3] = { -0.03f, 0.01f, 0.04f };
+        f32 highlights[3] = { 0.05f, 0.01f, -0.04f };
+
+        f32 *out = &rgb[((b * size + g) * size + i) * 3];
+        for (u32 c = 0; c < 3; ++c) {
+          f32 curve = in[c] * in[c] * (3.0f - 2.0f * in[c]);
+          f32 value = 0.5f * in[c] + 0.5f * curve;
+          value += shadows[c] * (1.0f - luma) + highlights[c] * luma;
+          out[c] = Clamp(0.0f, value, 1.0f);
+        }
+      }
+    }
+  }
+
+  renderer_add_lut(r, "film (built in)", size, rgb);
+}
+
+// Turns the enabled effects into as few passes as possible. Per pixel effects
+// (COLOR, LUT) are fused into the pass before them unless it already has one
+// of its kind, or would run them in the wrong order. Only leading ones and
+// repeats need a COPY pass of their own. Blurs are separable, two passes.
+static u32 effect_chain_compile(Effect_Chain *chain, u32 num_luts, Effect_Pass *passes, u32 *num_fused) {
+  u32 result = 0;
+  for (u32 i = 0; i < chain->num_effects; ++i) {
+    Effect *effect = &chain->effects[i];
+    if (!effect->is_enabled) continue;
+
+    Effect_Pass *last = result > 0 ? &passes[result - 1] : NULL;
+    switch (effect->type) {
+      case EFFECT_TYPE__COLOR: {
+        if (last && last->color < 0 && last->lut < 0) {
+          last->color = (s32)i;
+          (*num_fused)++;
+        } else {
+          passes[result++] = (Effect_Pass){ .kernel = EFFECT_KERNEL__COPY, .color = (s32)i, .lut = -1 };
+        }
+      } break;
+
+      case EFFECT_TYPE__LUT: {
+        if (effect->lut >= num_luts) break;
+        if (last && last->lut < 0) {
+          last->lut = (s32)i;
+          (*num_fused)++;
+        } else {
+          passes[result++] = (Effect_Pass){ .kernel = EFFECT_KERNEL__COPY, .color = -1, .lut = (s32)i };
+        }
+      } break;
+
+      case EFFECT_TYPE__BLUR: {
+        if (effect->params[0] <= 0.0f) break;
+        passes[result++] = (Effect_Pass){
+          .kernel = EFFECT_KERNEL__BLUR_X, .strength = effect->params[0], .color = -1, .lut = -1,
+        };
+        passes[result++] = (Effect_Pass){
+          .kernel = EFFECT_KERNEL__BLUR_Y, .strength = effect->params[0], .color = -1, .lut = -1,
+        };
+      } break;
+
+      case EFFECT_TYPE__SHARPEN: {
+        if (effect->params[0] == 0.0f) break;
+        passes[result++] = (Effect_Pass){
+          .kernel = EFFECT_KERNEL__SHARPEN, .strength = effect->params[0], .color = -1, .lut = -1,
+        };
+      } break;
+
+      default: break;
+    }
+  }
+  return result;
+}
+
+// Runs the layer's effects: its frame is converted to RGB in a pooled target
+// and then ping-pongs between two targets, one per pass. The result is left
+// in layer->effect_output for the compositor, which releases it. Targets are
+// as big as the frame is when it fills the project at scale 1, or the source
+// if that is smaller.
+static void renderer_apply_effects(Renderer *r, Render_Layer *layer, u32 quad_vertex, Renderer_Stats *stats) {
+  ProfileFuncBegin();
+
+  Effect_Pass passes[EFFECT_CHAIN_MAX * 2];
+  u32 num_passes = effect_chain_compile(&layer->effects, r->num_luts, passes, &stats->fused_effects);
+
+  YUV_Texture *texture = &layer->texture;
+  f32 fit_x = r->target.width / (f32)Max(texture->width, 1u);
+  f32 fit_y = r->target.height / (f32)Max(texture->height, 1u);
+  f32 fit = r->fit_mode == FIT_MODE__FIT ? Min(fit_x, fit_y) : Max(fit_x, fit_y);
+  fit = Min(fit, 1.0f);
+  u32 width = Max((u32)(texture->width * fit + 0.5f), 1u);
+  u32 height = Max((u32)(texture->height * fit + 0.5f), 1u);
+
+  s32 src = num_passes > 0 ? render_target_pool_acquire(&r->target_pool, width, height) : -1;
+  s32 dst = src >= 0 ? render_target_pool_acquire(&r->target_pool, width, height) : -1;
+
+  if (dst >= 0) {
+    glViewport(0, 0, width, height);
+
+    // convert to RGB first, effects work on display values
+    YUV_Shader *yuv_shader = &r->yuv_shader;
+    f32 white[3] = { 1.0f, 1.0f, 1.0f };
+    glBindFramebuffer(GL_FRAMEBUFFER, r->target_pool.targets[src].fbo);
+    glUseProgram(yuv_shader->program);
+    glUniform3fv(yuv_shader->draw_color, 1, white);
+    glUniform1i(yuv_shader->is_rgb, 0);
+    yuv_shader_set_color(yuv_shader, texture->layout, r->is_color_overridden ? r->color_override : texture->color);
+    for (u32 plane = 0; plane < 3; ++plane) {
+      glActiveTexture(GL_TEXTURE0 + plane);
+      glBindTexture(GL_TEXTURE_2D, texture->ids[plane]);
+    }
+    glDrawArrays(GL_TRIANGLES, quad_vertex, 6);
+    stats->draw_calls++;
+
+    Effect_Shader *shader = &r->effect_shader;
+    glUseProgram(shader->program);
+    glUniform2f(shader->texel_size, 1.0f / width, 1.0f / height);
+
+    for (u32 i = 0; i < num_passes; ++i) {
+      Effect_Pass *pass = &passes[i];
+
+      glBindFramebuffer(GL_FRAMEBUFFER, r->target_pool.targets[dst].fbo);
+      glActiveTexture(GL_TEXTURE0);
+      glBindTexture(GL_TEXTURE_2D, r->target_pool.targets[src].tex);
+
+      bool is_blur = pass->kernel == EFFECT_KERNEL__BLUR_X || pass->kernel == EFFECT_KERNEL__BLUR_Y;
+      glUniform1i(shader->kernel, pass->kernel);
+      glUniform1f(shader->strength, is_blur ? pass->strength * height : pass->strength);
+
+      glUniform1i(shader->has_color, pass->color >= 0);
+      if (pass->color >= 0) {
+        glUniform4fv(shader->color_params, 1, layer->effects.effects[pass->color].params);
+      }
+
+      glUniform1i(shader->has_lut, pass->lut >= 0);
+      if (pass->lut >= 0) {
+        Effect *effect = &layer->effects.effects[pass->lut];
+        Effect_Lut *lut = &r->luts[effect->lut];
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_3D, lut->texture);
+        glUniform1f(shader->lut_size, (f32)lut->size);
+        glUniform1f(shader->lut_mix, effect->params[0]);
+      }
+
+      glDrawArrays(GL_TRIANGLES, quad_vertex, 6);
+      stats->draw_calls++;
+      stats->effect_passes++;
+
+      s32 swap = src;
+      src = dst;
+      dst = swap;
+    }
+
+    layer->effect_output = src;
+  } else {
+    // out of targets, the layer is drawn without its effects
+    render_target_pool_release(&r->target_pool, src);
+  }
+  render_target_pool_release(&r->target_pool, dst);
+
+  ProfileEnd();
+}
+
+// Edits a clip's effect chain, reorders with the arrows.
+static void effect_chain_editor(Renderer *r, Effect_Chain *chain) {
+  ProfileFuncBegin();
+
+  for (u32 i = 0; i < chain->num_effects; ++i) {
+    Effect *effect = &chain->effects[i];
+    ImGui::PushID((s32)i);
+
+    ImGui::Checkbox("##enabled", &effect->is_enabled);
+    ImGui::SameLine();
+    ImGui::Text("%s", effect_type_names[effect->type]);
+    ImGui::SameLine();
+    bool move_up = ImGui::ArrowButton("up", ImGuiDir_Up) && i > 0;
+    ImGui::SameLine();
+    bool move_down = ImGui::ArrowButton("down", ImGuiDir_Down) && i + 1 < chain->num_effects;
+    ImGui::SameLine();
+    bool remove = ImGui::SmallButton("x");
+
+    f32 *params = effect->params;
+    switch (effect->type) {
+      case EFFECT_TYPE__COLOR: {
+        ImGui::SliderFloat("exposure", &params[0], -3.0f, 3.0f, "%.2f stops");
+        ImGui::SliderFloat("contrast", &params[1], 0.0f, 2.0f);
+        ImGui::SliderFloat("saturation", &params[2], 0.0f, 2.0f);
+        ImGui::SliderFloat("temperature", &params[3], -0.5f, 0.5f);
+      } break;
+      case EFFECT_TYPE__BLUR: {
+        ImGui::SliderFloat("radius", &params[0], 0.0f, 0.05f, "%.3f");
+      } break;
+      case EFFECT_TYPE__SHARPEN: {
+        ImGui::SliderFloat("amount", &params[0], 0.0f, 2.0f);
+      } break;
+      case EFFECT_TYPE__LUT: {
+        const char *preview = effect->lut < r->num_luts ? r->luts[effect->lut].name : "none";
+        if (ImGui::BeginCombo("table", preview)) {
+          for (u32 lut = 0; lut < r->num_luts; ++lut) {
+            if (ImGui::Selectable(r->luts[lut].name, effect->lut == lut)) effect->lut = lut;
+          }
+          ImGui::EndCombo();
+        }
+        ImGui::SliderFloat("mix", &params[0], 0.0f, 1.0f);
+      } break;
+      default: break;
+    }
+
+    ImGui::PopID();
+
+    if (move_up || move_down) {
+      u32 other = move_up ? i - 1 : i + 1;
+      Effect swap = chain->effects[other];
+      chain->effects[other] = *effect;
+      chain->effects[i] = swap;
+    } else if (remove) {
+      memmove(&chain->effects[i], &chain->effects[i + 1], (chain->num_effects - i - 1) * sizeof(Effect));
+      chain->num_effects--;
+      break;
+    }
+  }
+
+  if (chain->num_effects < EFFECT_CHAIN_MAX) {
+    s32 type = -1;
+    if (ImGui::Combo("add effect", &type, effect_type_names, NUM_EFFECT_TYPES) && type >= 0) {
+      Effect *effect = &chain->effects[chain->num_effects++];
+      *effect = (Effect){ .type = (Effect_Type)type, .is_enabled = true };
+      memcpy(effect->params, effect_default_params[type], sizeof(effect->params));
+    }
+  }
+
+  ProfileEnd();
+}
+
+// Reallocates the target when the size changed, its previous contents are lost.
+static void renderer_resize(Renderer *r, u32 width, u32 height) {
+  ProfileFuncBegin();
+
+  if (r->target.width != width || r->target.height != height) {
+    destroy_render_target(&r->target);
+    r->target = create_render_target(width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  }
+
+  ProfileEnd();
+}
+
+static void renderer_init(Renderer *r, u32 width, u32 height) {
   ProfileFuncBegin();
 
   r->draw_color[0] = 1.0f;
   r->draw_color[1] = 1.0f;
   r->draw_color[2] = 1.0f;
 
-  r->shader_program = create_shader_program();
-  glUniform1i(glGetUniformLocation(r->shader_program, "y_tex"), 0);
-  glUniform1i(glGetUniformLocation(r->shader_program, "u_tex"), 1);
-  glUniform1i(glGetUniformLocation(r->shader_program, "v_tex"), 2);
+  r->yuv_shader = create_yuv_shader();
+  r->effect_shader = create_effect_shader();
+  renderer_add_film_lut(r);
 
-  r->target = create_render_target(1280, 720);
+  r->target = create_render_target(width, height);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-  float vertices[] = {
-   -1.0f, 1.0f, 0.0f,  0.0f, 1.0f,
-    1.0f, 1.0f, 0.0f,  1.0f, 1.0f,
-    1.0f,-1.0f, 0.0f,  1.0f, 0.0f,
-   -1.0f,-1.0f, 0.0f,  0.0f, 0.0f,
-  };
-
-  u32 indices[] = {
-    0, 1, 2,
-    2, 3, 0,
-  };
+  glGenBuffers(UPLOAD_RING_SIZE * 3, &r->upload_ring.pbos[0][0]);
 
   glGenVertexArrays(1, &r->vao);
   glBindVertexArray(r->vao);
 
+  // refilled by every renderer_draw_layers
   glGenBuffers(1, &r->vbo);
   glBindBuffer(GL_ARRAY_BUFFER, r->vbo);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-  glGenBuffers(1, &r->ibo);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->ibo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+  glBufferData(GL_ARRAY_BUFFER, (RENDERER_MAX_LAYERS + 1) * 6 * sizeof(Layer_Vertex), NULL, GL_STREAM_DRAW);
 
-  u32 vertex_size = 5 * sizeof(f32);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vertex_size, (void*)0);
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, vertex_size, (void*)(3 * sizeof(f32)));
+  u32 vertex_size = sizeof(Layer_Vertex);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, vertex_size, (void*)offsetof(Layer_Vertex, x));
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, vertex_size, (void*)offsetof(Layer_Vertex, u));
+  glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, vertex_size, (void*)offsetof(Layer_Vertex, opacity));
 
   glEnableVertexAttribArray(0);
   glEnableVertexAttribArray(1);
+  glEnableVertexAttribArray(2);
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
 
   ProfileEnd();
 }
 
 static void renderer_shutdown(Renderer *r) {
-  // TODO: Delete stuff
+  ProfileFuncBegin();
+
+  glDeleteProgram(r->yuv_shader.program);
+  glDeleteProgram(r->effect_shader.program);
+  glDeleteVertexArrays(1, &r->vao);
+  glDeleteBuffers(1, &r->vbo);
+  destroy_render_target(&r->target);
+  render_target_pool_shutdown(&r->target_pool);
+  for (u32 i = 0; i < r->num_luts; ++i) {
+    glDeleteTextures(1, &r->luts[i].texture);
+  }
+  r->num_luts = 0;
+  glDeleteBuffers(UPLOAD_RING_SIZE * 3, &r->upload_ring.pbos[0][0]);
+  *r = {0};
+
+  ProfileEnd();
 }
 
 static void renderer_draw_debug_ui(Renderer *r) {
@@ -224,12 +1102,116 @@ static void renderer_draw_debug_ui(Renderer *r) {
 
   ImGui::ColorEdit3("draw color", r->draw_color);
 
+  Renderer_Stats *stats = &r->stats;
+  ImGui::Text("layers: %u, draw calls: %u, texture binds: %u, color changes: %u",
+              stats->layers, stats->draw_calls, stats->texture_binds, stats->color_changes);
+  u32 pooled = 0;
+  for (u32 i = 0; i < RENDER_TARGET_POOL_SIZE; ++i) {
+    if (r->target_pool.targets[i].fbo) pooled++;
+  }
+  ImGui::Text("effect passes: %u, fused effects: %u, pooled targets: %u (%u created)",
+              stats->effect_passes, stats->fused_effects, pooled, r->target_pool.created);
+
+  static char lut_path[MAX_PATH_LENGTH] = "./assets/look.cube";
+  ImGui::InputText("lut", lut_path, sizeof(lut_path));
+  ImGui::SameLine();
+  if (ImGui::Button("Load")) {
+    renderer_load_lut(r, lut_path);
+  }
+
+  ImGui::Checkbox("override color metadata", &r->is_color_overridden);
+  if (r->is_color_overridden) {
+    Video_Color *color = &r->color_override;
+    ImGui::Combo("matrix", (s32 *)&color->matrix, color_matrix_names, NUM_COLOR_MATRICES);
+    ImGui::Checkbox("full range", &color->is_full_range);
+    ImGui::Combo("transfer", (s32 *)&color->transfer, color_transfer_names, NUM_COLOR_TRANSFERS);
+  }
+
   ImGui::End();
 
   ProfileEnd();
 }
 
-static void renderer_draw(Renderer *r, YUV_Texture texture) {
+static const Layer_Transform layer_transform_identity = {
+  .scale = 1.0f,
+  .opacity = 1.0f,
+};
+
+static void renderer_begin_layers(Renderer *r) {
+  r->num_layers = 0;
+}
+
+// Queues a layer for renderer_draw_layers, layers past RENDERER_MAX_LAYERS are dropped.
+// effects may be NULL.
+static void renderer_push_layer(Renderer *r, YUV_Texture texture, Layer_Transform *transform,
+                                Effect_Chain *effects, s32 depth) {
+  if (r->num_layers < RENDERER_MAX_LAYERS && transform->opacity > 0.0f) {
+    Render_Layer *layer = &r->layers[r->num_layers++];
+    layer->texture = texture;
+    layer->transform = *transform;
+    layer->effects.num_effects = 0;
+    if (effects) layer->effects = *effects;
+    layer->depth = depth;
+    layer->effect_output = -1;
+  }
+}
+
+// Writes the layer's quad as two triangles. Positions are worked out in target
+// pixels with y down, the target's first row is the top of the image.
+static void renderer_layer_vertices(Renderer *r, Render_Layer *layer, Layer_Vertex *out) {
+  Layer_Transform *transform = &layer->transform;
+  f32 target_width = (f32)r->target.width;
+  f32 target_height = (f32)r->target.height;
+
+  // size of the whole frame once fitted or filled to the target
+  f32 fit_x = target_width / (f32)Max(layer->texture.width, 1u);
+  f32 fit_y = target_height / (f32)Max(layer->texture.height, 1u);
+  f32 fit = r->fit_mode == FIT_MODE__FIT ? Min(fit_x, fit_y) : Max(fit_x, fit_y);
+  f32 frame_width = layer->texture.width * fit * transform->scale;
+  f32 frame_height = layer->texture.height * fit * transform->scale;
+
+  f32 u0 = transform->crop[0];
+  f32 v0 = transform->crop[1];
+  f32 u1 = 1.0f - transform->crop[2];
+  f32 v1 = 1.0f - transform->crop[3];
+
+  // corners relative to the center of the uncropped frame
+  f32 corners[4][4] = {
+    { (u0 - 0.5f) * frame_width, (v0 - 0.5f) * frame_height, u0, v0 },
+    { (u1 - 0.5f) * frame_width, (v0 - 0.5f) * frame_height, u1, v0 },
+    { (u1 - 0.5f) * frame_width, (v1 - 0.5f) * frame_height, u1, v1 },
+    { (u0 - 0.5f) * frame_width, (v1 - 0.5f) * frame_height, u0, v1 },
+  };
+
+  f32 angle = transform->rotation * (f32)M_PI / 180.0f;
+  f32 cos_angle = cosf(angle);
+  f32 sin_angle = sinf(angle);
+  f32 center_x = target_width * (0.5f + transform->x);
+  f32 center_y = target_height * (0.5f + transform->y);
+
+  Layer_Vertex vertices[4];
+  for (u32 i = 0; i < 4; ++i) {
+    f32 x = corners[i][0] * cos_angle - corners[i][1] * sin_angle + center_x;
+    f32 y = corners[i][0] * sin_angle + corners[i][1] * cos_angle + center_y;
+    vertices[i] = (Layer_Vertex){
+      .x = x / target_width * 2.0f - 1.0f,
+      .y = y / target_height * 2.0f - 1.0f,
+      .u = corners[i][2],
+      .v = corners[i][3],
+      .opacity = transform->opacity,
+    };
+  }
+
+  u32 indices[6] = { 0, 1, 2, 2, 3, 0 };
+  for (u32 i = 0; i < 6; ++i) {
+    out[i] = vertices[indices[i]];
+  }
+}
+
+// Composites the queued layers into the target in one pass. All quads are
+// uploaded at once, each layer then only binds its textures and, when it
+// differs from the layer below, its color conversion.
+static void renderer_draw_layers(Renderer *r) {
   ProfileFuncBegin();
 
   int err = glGetError();
@@ -237,24 +1219,133 @@ static void renderer_draw(Renderer *r, YUV_Texture texture) {
     fprintf(stderr, "GL ERROR: %d\n", err);
   }
 
-  glUseProgram(r->shader_program);
-  glBindFramebuffer(GL_FRAMEBUFFER, r->target.fbo);
-  glViewport(0, 0, r->target.width, r->target.height);
+  // a handful of layers, mostly sorted already
+  for (u32 i = 1; i < r->num_layers; ++i) {
+    Render_Layer layer = r->layers[i];
+    u32 j = i;
+    for (; j > 0 && r->layers[j - 1].depth > layer.depth; --j) {
+      r->layers[j] = r->layers[j - 1];
+    }
+    r->layers[j] = layer;
+  }
 
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, texture.ids[0]);
-  glActiveTexture(GL_TEXTURE1);
-  glBindTexture(GL_TEXTURE_2D, texture.ids[1]);
-  glActiveTexture(GL_TEXTURE2);
-  glBindTexture(GL_TEXTURE_2D, texture.ids[2]);
+  Layer_Vertex vertices[(RENDERER_MAX_LAYERS + 1) * 6];
+  for (u32 i = 0; i < r->num_layers; ++i) {
+    renderer_layer_vertices(r, &r->layers[i], &vertices[i * 6]);
+  }
 
-  s32 loc = glGetUniformLocation(r->shader_program, "draw_color");
-  glUniform3fv(loc, 1, r->draw_color);
+  // the whole target, for effect passes
+  u32 quad_vertex = r->num_layers * 6;
+  Layer_Vertex corners[4] = {
+    { -1.0f, -1.0f, 0.0f, 0.0f, 1.0f },
+    {  1.0f, -1.0f, 1.0f, 0.0f, 1.0f },
+    {  1.0f,  1.0f, 1.0f, 1.0f, 1.0f },
+    { -1.0f,  1.0f, 0.0f, 1.0f, 1.0f },
+  };
+  u32 indices[6] = { 0, 1, 2, 2, 3, 0 };
+  for (u32 i = 0; i < 6; ++i) {
+    vertices[quad_vertex + i] = corners[indices[i]];
+  }
+
+  Renderer_Stats stats = {0};
+  stats.layers = r->num_layers;
+
+  glBindBuffer(GL_ARRAY_BUFFER, r->vbo);
+  // orphan the previous frame's vertices instead of waiting for the GPU to finish with them
+  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), NULL, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, (quad_vertex + 6) * sizeof(Layer_Vertex), vertices);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
 
+  // effects render into their own targets before the target is touched
   glBindVertexArray(r->vao);
-  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+  for (u32 i = 0; i < r->num_layers; ++i) {
+    if (r->layers[i].effects.num_effects > 0) {
+      renderer_apply_effects(r, &r->layers[i], quad_vertex, &stats);
+    }
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, r->target.fbo);
+  glViewport(0, 0, r->target.width, r->target.height);
+  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  YUV_Shader *shader = &r->yuv_shader;
+  glUseProgram(shader->program);
+  glUniform3fv(shader->draw_color, 1, r->draw_color);
+  glUniform1i(shader->is_rgb, 0);
+
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  u32 bound[3] = {0};
+
+  bool has_color = false;
+  bool last_is_rgb = false;
+  Pixel_Layout last_layout = PIXEL_LAYOUT__YUV420P;
+  Video_Color last_color = {};
+
+  for (u32 i = 0; i < r->num_layers; ++i) {
+    Render_Layer *layer = &r->layers[i];
+    YUV_Texture *texture = &layer->texture;
+    bool is_rgb = layer->effect_output >= 0;
+
+    if (is_rgb) {
+      u32 id = r->target_pool.targets[layer->effect_output].tex;
+      if (bound[0] != id) {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, id);
+        bound[0] = id;
+        stats.texture_binds++;
+      }
+    } else {
+      for (u32 plane = 0; plane < 3; ++plane) {
+        if (bound[plane] != texture->ids[plane]) {
+          glActiveTexture(GL_TEXTURE0 + plane);
+          glBindTexture(GL_TEXTURE_2D, texture->ids[plane]);
+          bound[plane] = texture->ids[plane];
+          stats.texture_binds++;
+        }
+      }
+    }
+
+    if (is_rgb != last_is_rgb) {
+      glUniform1i(shader->is_rgb, is_rgb);
+      last_is_rgb = is_rgb;
+      stats.color_changes++;
+    }
+
+    Video_Color color = r->is_color_overridden ? r->color_override : texture->color;
+    if (!is_rgb && (!has_color || texture->layout != last_layout || color.matrix != last_color.matrix ||
+                    color.is_full_range != last_color.is_full_range || color.transfer != last_color.transfer)) {
+      yuv_shader_set_color(shader, texture->layout, color);
+
+      has_color = true;
+      last_layout = texture->layout;
+      last_color = color;
+      stats.color_changes++;
+    }
+
+    glDrawArrays(GL_TRIANGLES, i * 6, 6);
+    stats.draw_calls++;
+
+    render_target_pool_release(&r->target_pool, layer->effect_output);
+    layer->effect_output = -1;
+  }
 
+  glBindVertexArray(0);
+  glDisable(GL_BLEND);
+  glActiveTexture(GL_TEXTURE0);
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+  r->stats = stats;
+
   ProfileEnd();
 }
+
+// Draws a single frame over the whole target, as placed by the fit mode.
+static void renderer_draw(Renderer *r, YUV_Texture texture) {
+  Layer_Transform transform = layer_transform_identity;
+  renderer_begin_layers(r);
+  renderer_push_layer(r, texture, &transform, NULL, 0);
+  renderer_draw_layers(r);
+}
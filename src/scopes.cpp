@@ -0,0 +1,96 @@
+static void scopes_init(Scopes *scopes, Render_Target *target) {
+  ProfileFuncBegin();
+
+  readback_ring_init(&scopes->readback, target->width, target->height);
+
+  ProfileEnd();
+}
+
+// Keeps the readback ring the size of the target, pending readbacks are dropped.
+static void scopes_resize(Scopes *scopes, Render_Target *target) {
+  ProfileFuncBegin();
+
+  Readback_Ring *readback = &scopes->readback;
+  if (readback->width != target->width || readback->height != target->height) {
+    readback_ring_shutdown(readback);
+    readback_ring_init(readback, target->width, target->height);
+  }
+
+  ProfileEnd();
+}
+
+static void scopes_shutdown(Scopes *scopes) {
+  ProfileFuncBegin();
+
+  readback_ring_shutdown(&scopes->readback);
+
+  ProfileEnd();
+}
+
+// Queues a readback of the frame that was just rendered. Skipped while the
+// ring is full, the scopes only need to keep up roughly.
+static void scopes_capture(Scopes *scopes, Render_Target *target) {
+  ProfileFuncBegin();
+
+  if (scopes->is_enabled) {
+    readback_ring_push(&scopes->readback, target);
+  }
+
+  ProfileEnd();
+}
+
+static void scopes_compute_histogram(Scopes *scopes, u8 *pixels) {
+  ProfileFuncBegin();
+
+  Readback_Ring *readback = &scopes->readback;
+  u32 counts[256] = {0};
+
+  // every other pixel of every other row is plenty for a histogram
+  for (u32 y = 0; y < readback->height; y += 2) {
+    u8 *row = pixels + (u64)y * readback->width * 4;
+    for (u32 x = 0; x < readback->width; x += 2) {
+      u8 *p = row + x * 4;
+      // BT.709 luma weights in 8.8 fixed point
+      u32 luma = (54 * p[0] + 183 * p[1] + 19 * p[2]) >> 8;
+      counts[luma]++;
+    }
+  }
+
+  u32 max_count = 1;
+  for (u32 i = 0; i < 256; ++i) max_count = Max(max_count, counts[i]);
+  for (u32 i = 0; i < 256; ++i) scopes->histogram[i] = (f32)counts[i] / (f32)max_count;
+
+  ProfileEnd();
+}
+
+// Picks up readbacks the GPU has finished, never waits on it.
+static void scopes_update(Scopes *scopes) {
+  ProfileFuncBegin();
+
+  Readback_Ring *readback = &scopes->readback;
+
+  u8 *pixels = NULL;
+  while ((pixels = readback_ring_map(readback, false)) != NULL) {
+    // only the newest frame matters
+    if (readback_ring_count(readback) == 1 && scopes->is_enabled) {
+      scopes_compute_histogram(scopes, pixels);
+    }
+    readback_ring_unmap(readback);
+  }
+
+  ProfileEnd();
+}
+
+static void scopes_window(Scopes *scopes) {
+  ProfileFuncBegin();
+
+  if (ImGui::Begin("Scopes")) {
+    ImGui::Checkbox("enabled", &scopes->is_enabled);
+    ImGui::PlotHistogram("##luma", scopes->histogram, 256, 0, "luma", 0.0f, 1.0f,
+                         ImVec2(ImGui::GetContentRegionAvail().x, 120.0f));
+    ImGui::Text("readback stalls: %llu", scopes->readback.stalls);
+  }
+  ImGui::End();
+
+  ProfileEnd();
+}
@@ -68,12 +68,56 @@ static void update_sequencer(Sequencer *seq, f32 delta_time) {
 
   if (seq->state == PLAYBACK_STATE__PLAY) {
     seq->playback_time += delta_time;
+
+    if (seq->playback_time >= seq->max_time) {
+      seq->playback_time = seq->max_time;
+      seq->state = PLAYBACK_STATE__PAUSE;
+    }
   }
 
   ProfileEnd();
 }
 
-static void draw_sequencer(Sequencer *seq) {
+// Follows an external clock (the audio output) instead of advancing by frame time.
+static void update_sequencer_from_clock(Sequencer *seq, f64 clock_time) {
+  ProfileFuncBegin();
+
+  if (seq->state == PLAYBACK_STATE__PLAY) {
+    seq->playback_time = clock_time;
+
+    if (seq->playback_time >= seq->max_time) {
+      seq->playback_time = seq->max_time;
+      seq->state = PLAYBACK_STATE__PAUSE;
+    }
+  }
+
+  ProfileEnd();
+}
+
+static void draw_clip(Sequencer *seq, ImDrawList *painter, Timeline *tl, Thumbnail_Strip *thumbnails,
+                      ImVec2 timeline_pos, f32 y, Timeline_Clip *clip) {
+  ProfileFuncBegin();
+
+  f64 start = clip->start;
+  f64 end = timeline_clip_end(clip);
+  ImVec2 p0 = ImVec2(timeline_pos.x + (start - seq->pan) * seq->zoom, y);
+  ImVec2 p1 = ImVec2(timeline_pos.x + (end - seq->pan) * seq->zoom, y + seq->track_height);
+
+  painter->AddRectFilled(p0, p1, seq->theme.secondary);
+  if (thumbnails && thumbnails->source_id == tl->sources[clip->source].id) {
+    draw_thumbnail_strip(painter, thumbnails, p0, p1, clip->in_point, clip->out_point);
+  }
+  painter->AddRect(p0, p1, seq->theme.accent, 0.0f, 0, seq->border_width);
+
+  ProfileEnd();
+}
+
+// Track rows top to bottom, the highest track is drawn at the top.
+static inline f32 sequencer_track_y(Sequencer *seq, Timeline *tl, f32 editor_y, u32 track) {
+  return editor_y + 4.0f + (tl->num_tracks - 1 - track) * (seq->track_height + 4.0f);
+}
+
+static void draw_sequencer(Sequencer *seq, Timeline *tl, Thumbnail_Strip *thumbnails) {
   ProfileFuncBegin();
 
   ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2{0.0f, 0.0f});
@@ -154,6 +198,18 @@ static void draw_sequencer(Sequencer *seq) {
     }
 
 
+    // clips
+    u32 *visible_clips;
+    u32 num_visible_clips = timeline_query(tl, second_left, second_right, &visible_clips);
+
+    painter->PushClipRect(editor_pos, editor_pos + window_size, true);
+    for (u32 i = 0; i < num_visible_clips; ++i) {
+      Timeline_Clip *clip = &tl->clips[visible_clips[i]];
+      f32 y = sequencer_track_y(seq, tl, editor_pos.y, clip->track);
+      draw_clip(seq, painter, tl, thumbnails, timeline_pos, y, clip);
+    }
+    painter->PopClipRect();
+
     // Time indicator
     //time_indicator(seq, painter, window_pos, window_size, timeline_pos);
 
@@ -177,6 +233,12 @@ static void draw_sequencer(Sequencer *seq) {
                     empty_sq_pos + ImVec2{seq->lister_width, seq->timeline_height},
                     seq->theme.secondary, seq->border_width);
 
+    // track names
+    for (u32 track = 0; track < tl->num_tracks; ++track) {
+      f32 y = sequencer_track_y(seq, tl, lister_pos.y, track);
+      painter->AddText(ImVec2{lister_pos.x + 8.0f, y + 4.0f}, seq->theme.text, tl->tracks[track].name);
+    }
+
     // lister border
     painter->AddLine(lister_pos + ImVec2{seq->lister_width, 0.0f},
                     lister_pos + ImVec2{seq->lister_width, window_size.y},
@@ -184,6 +246,7 @@ static void draw_sequencer(Sequencer *seq) {
   
     ImGui::Text("w: %f, sec w: %f", timeline_screen_w, timeline_sec_w);
     ImGui::Text("left: %f, right: %f", second_left, second_right);
+    ImGui::Text("clips: %u visible of %u", num_visible_clips, tl->num_clips);
   }
   ImGui::End();
   ImGui::PopStyleVar(2);
@@ -197,6 +260,7 @@ static void draw_sequencer(Sequencer *seq) {
   }
   ImGui::DragFloat("pan", &seq->pan, 0.01f);
   ImGui::DragFloat("timeline height", &seq->timeline_height, 1.0f, 0.0f, 1000.0f);
+  ImGui::DragFloat("track height", &seq->track_height, 1.0f, 10.0f, 500.0f);
   ImGui::DragFloat("lister width", &seq->lister_width, 1.0f, 1.0f, 1000.0f);
   ImGui::DragFloat("border width", &seq->border_width, 0.1f, 1.0f, 1000.0f);
   ImGui::End();
@@ -0,0 +1,388 @@
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "imstb_truetype.h"
+
+const char *text_vertex_shader_source = R"(
+  #version 330 core
+
+  layout (location = 0) in vec2 a_pos;
+  layout (location = 1) in vec2 a_uv;
+  layout (location = 2) in vec4 a_color;
+
+  out vec2 pass_uv;
+  out vec4 pass_color;
+
+  void main() {
+    pass_uv = a_uv;
+    pass_color = a_color;
+    gl_Position = vec4(a_pos, 0.0f, 1.0f);
+  }
+)";
+
+const char *text_fragment_shader_source = R"(
+  #version 330 core
+
+  in vec2 pass_uv;
+  in vec4 pass_color;
+  out vec4 frag_color;
+
+  uniform sampler2D atlas;
+  uniform vec4 outline_color;
+  uniform float outline_width;
+
+  void main() {
+    // distance field, 0.5 is the glyph's edge
+    float d = texture(atlas, pass_uv).r;
+    float aa = max(fwidth(d) * 0.75, 1.0 / 255.0);
+
+    float fill = smoothstep(0.5 - aa, 0.5 + aa, d);
+    float edge = 0.5 - outline_width;
+    float coverage = smoothstep(edge - aa, edge + aa, d);
+
+    vec4 color = mix(outline_color, pass_color, fill);
+    frag_color = vec4(color.rgb, color.a * coverage * pass_color.a);
+  }
+)";
+
+static inline u32 rgba8(f32 r, f32 g, f32 b, f32 a) {
+  return (u32)(Clamp(0.0f, r, 1.0f) * 255.0f + 0.5f) |
+         (u32)(Clamp(0.0f, g, 1.0f) * 255.0f + 0.5f) << 8 |
+         (u32)(Clamp(0.0f, b, 1.0f) * 255.0f + 0.5f) << 16 |
+         (u32)(Clamp(0.0f, a, 1.0f) * 255.0f + 0.5f) << 24;
+}
+
+// Returns the codepoint at *text and advances past it. Invalid bytes come out as U+FFFD.
+static u32 utf8_next(const char **text, const char *end) {
+  const u8 *s = (const u8 *)*text;
+  u32 length = s[0] < 0x80 ? 1 : (s[0] >> 5) == 0x6 ? 2 : (s[0] >> 4) == 0xe ? 3 : (s[0] >> 3) == 0x1e ? 4 : 0;
+
+  u32 result = 0xfffd;
+  if (length == 0 || (const char *)s + length > end) {
+    length = 1;
+  } else if (length == 1) {
+    result = s[0];
+  } else {
+    result = s[0] & (0x7f >> length);
+    for (u32 i = 1; i < length; ++i) {
+      result = (result << 6) | (s[i] & 0x3f);
+    }
+  }
+
+  *text += length;
+  return result;
+}
+
+static bool glyph_atlas_init(Glyph_Atlas *atlas, const char *font_path) {
+  ProfileFuncBegin();
+
+  *atlas = {0};
+
+  bool result = false;
+  FILE *file = fopen(font_path, "rb");
+  if (file) {
+    fseek(file, 0, SEEK_END);
+    u64 size = (u64)ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    atlas->arena = arena_alloc((Arena_Params){
+      .name = "font",
+      .reserve_size = size + MiB(1),
+      .commit_size = MiB(1),
+    });
+    u8 *font_data = push_array_no_zero(atlas->arena, u8, size);
+    bool is_read = fread(font_data, 1, size, file) == size;
+    fclose(file);
+
+    if (is_read && stbtt_InitFont(&atlas->font, font_data, stbtt_GetFontOffsetForIndex(font_data, 0))) {
+      atlas->scale = stbtt_ScaleForPixelHeight(&atlas->font, GLYPH_PIXEL_HEIGHT);
+
+      s32 ascent, descent, line_gap;
+      stbtt_GetFontVMetrics(&atlas->font, &ascent, &descent, &line_gap);
+      atlas->ascent = ascent * atlas->scale;
+      atlas->descent = descent * atlas->scale;
+      atlas->line_gap = line_gap * atlas->scale;
+
+      // starts out cleared, glyphs are only written into their own rects
+      Temp scratch = scratch_begin(&atlas->arena, 1);
+      u8 *zeros = push_array(scratch.arena, u8, GLYPH_ATLAS_SIZE * GLYPH_ATLAS_SIZE);
+
+      glGenTextures(1, &atlas->texture);
+      glBindTexture(GL_TEXTURE_2D, atlas->texture);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, GLYPH_ATLAS_SIZE, GLYPH_ATLAS_SIZE, 0, GL_RED, GL_UNSIGNED_BYTE, zeros);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glBindTexture(GL_TEXTURE_2D, 0);
+
+      scratch_end(scratch);
+      result = true;
+    }
+  }
+
+  if (!result) {
+    fprintf(stderr, "Could not load font '%s'\n", font_path);
+    if (atlas->arena) arena_release(atlas->arena);
+    *atlas = {0};
+  }
+
+  ProfileEnd();
+
+  return result;
+}
+
+static void glyph_atlas_shutdown(Glyph_Atlas *atlas) {
+  if (atlas->arena) {
+    glDeleteTextures(1, &atlas->texture);
+    arena_release(atlas->arena);
+  }
+  *atlas = {0};
+}
+
+// Rasterizes the glyph into the atlas. When the atlas is full the glyph is
+// kept without a rect and only advances the pen.
+static void glyph_atlas_rasterize(Glyph_Atlas *atlas, Glyph *glyph) {
+  ProfileFuncBegin();
+
+  s32 advance, left_side_bearing;
+  stbtt_GetCodepointHMetrics(&atlas->font, glyph->codepoint, &advance, &left_side_bearing);
+  glyph->advance = advance * atlas->scale;
+
+  s32 width = 0, height = 0, x_offset = 0, y_offset = 0;
+  // 128 is the edge, the distance falls off by 128 over the padding
+  u8 *sdf = stbtt_GetCodepointSDF(&atlas->font, atlas->scale, glyph->codepoint, GLYPH_SDF_PADDING,
+                                  128, 128.0f / GLYPH_SDF_PADDING, &width, &height, &x_offset, &y_offset);
+
+  if (sdf) {
+    if (atlas->pen_x + width > GLYPH_ATLAS_SIZE) {
+      atlas->pen_x = 0;
+      atlas->pen_y += atlas->row_height + 1;
+      atlas->row_height = 0;
+    }
+
+    if (atlas->pen_y + height > GLYPH_ATLAS_SIZE) {
+      atlas->is_full = true;
+    } else {
+      glyph->x = (u16)atlas->pen_x;
+      glyph->y = (u16)atlas->pen_y;
+      glyph->width = (u16)width;
+      glyph->height = (u16)height;
+      glyph->x_offset = (f32)x_offset;
+      glyph->y_offset = (f32)y_offset;
+
+      glBindTexture(GL_TEXTURE_2D, atlas->texture);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, glyph->x, glyph->y, width, height, GL_RED, GL_UNSIGNED_BYTE, sdf);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+      glBindTexture(GL_TEXTURE_2D, 0);
+
+      atlas->pen_x += width + 1;
+      atlas->row_height = Max(atlas->row_height, (u32)height);
+    }
+
+    stbtt_FreeSDF(sdf, NULL);
+  }
+
+  ProfileEnd();
+}
+
+// Returns the cached glyph, rasterizing it on first use. NULL once the cache is full.
+static Glyph *glyph_atlas_get(Glyph_Atlas *atlas, u32 codepoint, Text_Stats *stats) {
+  Glyph *result = NULL;
+
+  // open addressing with linear probing, glyphs are never removed
+  u32 mask = GLYPH_CACHE_SIZE - 1;
+  for (u32 i = 0, slot = (codepoint * 2654435761u) & mask; i < GLYPH_CACHE_SIZE; ++i, slot = (slot + 1) & mask) {
+    Glyph *glyph = &atlas->glyphs[slot];
+    if (glyph->codepoint == codepoint) {
+      result = glyph;
+      break;
+    }
+    if (glyph->codepoint == 0) {
+      // keep a few slots free so probing stays short
+      if (atlas->num_glyphs < GLYPH_CACHE_SIZE * 3 / 4) {
+        glyph->codepoint = codepoint;
+        atlas->num_glyphs++;
+        glyph_atlas_rasterize(atlas, glyph);
+        stats->rasterized++;
+        result = glyph;
+      }
+      break;
+    }
+  }
+
+  return result;
+}
+
+static bool text_renderer_init(Text_Renderer *tr, const char *font_path) {
+  ProfileFuncBegin();
+
+  *tr = {0};
+  tr->is_loaded = glyph_atlas_init(&tr->atlas, font_path);
+
+  if (tr->is_loaded) {
+    Text_Shader *shader = &tr->shader;
+    shader->program = create_shader_program(text_vertex_shader_source, text_fragment_shader_source);
+    glUniform1i(glGetUniformLocation(shader->program, "atlas"), 0);
+    shader->outline_color = glGetUniformLocation(shader->program, "outline_color");
+    shader->outline_width = glGetUniformLocation(shader->program, "outline_width");
+
+    tr->arena = arena_alloc((Arena_Params){
+      .name = "text vertices",
+      .reserve_size = TEXT_MAX_GLYPHS * 6 * sizeof(Text_Vertex),
+      .commit_size = TEXT_MAX_GLYPHS * 6 * sizeof(Text_Vertex),
+    });
+    tr->vertices = push_array_no_zero(tr->arena, Text_Vertex, TEXT_MAX_GLYPHS * 6);
+
+    glGenVertexArrays(1, &tr->vao);
+    glBindVertexArray(tr->vao);
+
+    glGenBuffers(1, &tr->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, tr->vbo);
+    glBufferData(GL_ARRAY_BUFFER, TEXT_MAX_GLYPHS * 6 * sizeof(Text_Vertex), NULL, GL_STREAM_DRAW);
+
+    u32 vertex_size = sizeof(Text_Vertex);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, vertex_size, (void*)offsetof(Text_Vertex, x));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, vertex_size, (void*)offsetof(Text_Vertex, u));
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, vertex_size, (void*)offsetof(Text_Vertex, color));
+
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+
+  ProfileEnd();
+
+  return tr->is_loaded;
+}
+
+static void text_renderer_shutdown(Text_Renderer *tr) {
+  ProfileFuncBegin();
+
+  if (tr->is_loaded) {
+    glDeleteBuffers(1, &tr->vbo);
+    glDeleteVertexArrays(1, &tr->vao);
+    glDeleteProgram(tr->shader.program);
+    arena_release(tr->arena);
+    glyph_atlas_shutdown(&tr->atlas);
+  }
+  *tr = {0};
+
+  ProfileEnd();
+}
+
+// Width in pixels of the text drawn pixel_height tall.
+static f32 text_measure(Text_Renderer *tr, const char *text, u32 length, f32 pixel_height) {
+  Glyph_Atlas *atlas = &tr->atlas;
+  f32 scale = pixel_height / GLYPH_PIXEL_HEIGHT;
+
+  f32 result = 0.0f;
+  const char *end = text + length;
+  u32 previous = 0;
+  while (text < end) {
+    u32 codepoint = utf8_next(&text, end);
+    Glyph *glyph = glyph_atlas_get(atlas, codepoint, &tr->stats);
+    if (previous) {
+      result += stbtt_GetCodepointKernAdvance(&atlas->font, previous, codepoint) * atlas->scale * scale;
+    }
+    if (glyph) result += glyph->advance * scale;
+    previous = codepoint;
+  }
+
+  return result;
+}
+
+static void text_begin(Text_Renderer *tr) {
+  tr->num_vertices = 0;
+}
+
+// Queues the text with its baseline starting at (x, y), in pixels of target
+// with y down. Returns the x after the last glyph.
+static f32 text_push(Text_Renderer *tr, Render_Target *target, const char *text, u32 length,
+                     f32 x, f32 y, f32 pixel_height, u32 color) {
+  Glyph_Atlas *atlas = &tr->atlas;
+  f32 scale = pixel_height / GLYPH_PIXEL_HEIGHT;
+  f32 to_ndc_x = 2.0f / target->width;
+  f32 to_ndc_y = 2.0f / target->height;
+  f32 to_uv = 1.0f / GLYPH_ATLAS_SIZE;
+
+  const char *end = text + length;
+  u32 previous = 0;
+  while (text < end) {
+    u32 codepoint = utf8_next(&text, end);
+    Glyph *glyph = glyph_atlas_get(atlas, codepoint, &tr->stats);
+    if (glyph == NULL) continue;
+
+    if (previous) {
+      x += stbtt_GetCodepointKernAdvance(&atlas->font, previous, codepoint) * atlas->scale * scale;
+    }
+    previous = codepoint;
+
+    if (glyph->width > 0 && tr->num_vertices + 6 <= TEXT_MAX_GLYPHS * 6) {
+      f32 x0 = (x + glyph->x_offset * scale) * to_ndc_x - 1.0f;
+      f32 y0 = (y + glyph->y_offset * scale) * to_ndc_y - 1.0f;
+      f32 x1 = x0 + glyph->width * scale * to_ndc_x;
+      f32 y1 = y0 + glyph->height * scale * to_ndc_y;
+      f32 u0 = glyph->x * to_uv;
+      f32 v0 = glyph->y * to_uv;
+      f32 u1 = (glyph->x + glyph->width) * to_uv;
+      f32 v1 = (glyph->y + glyph->height) * to_uv;
+
+      Text_Vertex *v = &tr->vertices[tr->num_vertices];
+      v[0] = (Text_Vertex){ x0, y0, u0, v0, color };
+      v[1] = (Text_Vertex){ x1, y0, u1, v0, color };
+      v[2] = (Text_Vertex){ x1, y1, u1, v1, color };
+      v[3] = v[2];
+      v[4] = (Text_Vertex){ x0, y1, u0, v1, color };
+      v[5] = v[0];
+      tr->num_vertices += 6;
+    }
+
+    x += glyph->advance * scale;
+  }
+
+  return x;
+}
+
+// Draws everything queued since text_begin over the target in one draw call.
+static void text_flush(Text_Renderer *tr, Render_Target *target, const f32 *outline_color, f32 outline_width) {
+  ProfileFuncBegin();
+
+  tr->stats.glyphs = tr->num_vertices / 6;
+  tr->stats.draw_calls = 0;
+
+  if (tr->num_vertices > 0) {
+    glBindBuffer(GL_ARRAY_BUFFER, tr->vbo);
+    glBufferData(GL_ARRAY_BUFFER, TEXT_MAX_GLYPHS * 6 * sizeof(Text_Vertex), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, tr->num_vertices * sizeof(Text_Vertex), tr->vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+    glViewport(0, 0, target->width, target->height);
+
+    glUseProgram(tr->shader.program);
+    glUniform4fv(tr->shader.outline_color, 1, outline_color);
+    glUniform1f(tr->shader.outline_width, outline_width);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, tr->atlas.texture);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBindVertexArray(tr->vao);
+    glDrawArrays(GL_TRIANGLES, 0, tr->num_vertices);
+    tr->stats.draw_calls++;
+
+    glBindVertexArray(0);
+    glDisable(GL_BLEND);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  }
+
+  tr->num_vertices = 0;
+
+  ProfileEnd();
+}
@@ -0,0 +1,196 @@
+static void thumbnail_strip_generate(Thumbnail_Strip *strip, Video *video, SwsContext **sws_ctx, u32 index) {
+  ProfileFuncBegin();
+
+  u8 *dest = strip->pixels + (u64)index * strip->width * strip->height * 4;
+
+  // start of the thumbnail's interval, the keyframe at or before it is used
+  f64 sec = index * strip->interval;
+  if (video_seek_keyframe(video, sec)) {
+    AVFrame *frame = video->frame;
+    *sws_ctx = sws_getCachedContext(*sws_ctx, frame->width, frame->height, (AVPixelFormat)frame->format,
+                                    strip->width, strip->height, AV_PIX_FMT_RGBA,
+                                    SWS_AREA, NULL, NULL, NULL);
+
+    u8 *dest_planes[4] = { dest, NULL, NULL, NULL };
+    s32 dest_linesize[4] = { (s32)strip->width * 4, 0, 0, 0 };
+    chk_err(sws_scale(*sws_ctx, frame->data, frame->linesize, 0, frame->height,
+                      dest_planes, dest_linesize));
+  } else {
+    memset(dest, 0, strip->width * strip->height * 4);
+  }
+
+  strip->thumbnails[index].is_ready = true;
+
+  ProfileEnd();
+}
+
+static void *thumbnail_strip_thread(void *ptr) {
+  Thumbnail_Strip *strip = (Thumbnail_Strip *)ptr;
+
+  profile_thread_init();
+
+  Video video = {0};
+  if (video_open(&video, strip->path, VIDEO_OPEN_FLAG__KEYFRAMES_ONLY)) {
+    SwsContext *sws_ctx = NULL;
+
+    // coarse to fine, so the whole strip fills in quickly on long sources
+    u32 step = 1;
+    while (step * 2 < strip->count) step *= 2;
+
+    for (; step > 0 && !strip->cancel; step /= 2) {
+      for (u32 i = 0; i < strip->count && !strip->cancel; i += step) {
+        if (!strip->thumbnails[i].is_ready) {
+          thumbnail_strip_generate(strip, &video, &sws_ctx, i);
+        }
+      }
+    }
+
+    sws_freeContext(sws_ctx);
+    video_close(&video);
+  }
+
+  profile_thread_shutdown();
+
+  scratch_release_thread();
+
+  return NULL;
+}
+
+static void thumbnail_strip_init(Thumbnail_Strip *strip, Video *video, const char *path) {
+  ProfileFuncBegin();
+
+  snprintf(strip->path, MAX_PATH_LENGTH, "%s", path);
+  strip->source_id = video->source_id;
+  strip->cancel = false;
+  strip->duration = video_duration(video);
+
+  // fit the source's aspect ratio into THUMBNAIL_MAX_SIZE
+  if (video->width >= video->height) {
+    strip->width = THUMBNAIL_MAX_SIZE;
+    strip->height = Max(1, THUMBNAIL_MAX_SIZE * video->height / Max(video->width, 1));
+  } else {
+    strip->height = THUMBNAIL_MAX_SIZE;
+    strip->width = Max(1, THUMBNAIL_MAX_SIZE * video->width / Max(video->height, 1));
+  }
+
+  strip->columns = THUMBNAIL_ATLAS_SIZE / strip->width;
+  u32 max_count = strip->columns * (THUMBNAIL_ATLAS_SIZE / strip->height);
+  strip->count = (u32)Clamp(1.0, ceil(strip->duration / THUMBNAIL_MIN_INTERVAL), (f64)max_count);
+  strip->interval = strip->duration > 0.0 ? strip->duration / strip->count : THUMBNAIL_MIN_INTERVAL;
+  strip->num_uploaded = 0;
+
+  u64 thumbnail_bytes = (u64)strip->width * strip->height * 4;
+  strip->arena = arena_alloc((Arena_Params){
+    .name = "thumbnails",
+    .reserve_size = ARENA_DEFAULT_RESERVE_SIZE,
+    .commit_size = ARENA_DEFAULT_COMMIT_SIZE,
+  });
+  strip->pixels = push_array_no_zero(strip->arena, u8, thumbnail_bytes * strip->count);
+  strip->thumbnails = push_array(strip->arena, Thumbnail, strip->count);
+
+  u32 rows = (strip->count + strip->columns - 1) / strip->columns;
+  glGenTextures(1, &strip->atlas_tex);
+  glBindTexture(GL_TEXTURE_2D, strip->atlas_tex);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, strip->columns * strip->width, rows * strip->height,
+               0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  pthread_create(&strip->thread, NULL, thumbnail_strip_thread, (void *)strip);
+
+  ProfileEnd();
+}
+
+static void thumbnail_strip_shutdown(Thumbnail_Strip *strip) {
+  ProfileFuncBegin();
+
+  strip->cancel = true;
+  pthread_join(strip->thread, NULL);
+
+  glDeleteTextures(1, &strip->atlas_tex);
+  arena_release(strip->arena);
+  strip->arena = NULL;
+  strip->pixels = NULL;
+  strip->thumbnails = NULL;
+
+  ProfileEnd();
+}
+
+// Copies thumbnails the generator has finished into the atlas, a few per frame.
+static void thumbnail_strip_update(Thumbnail_Strip *strip) {
+  ProfileFuncBegin();
+
+  if (strip->num_uploaded < strip->count) {
+    glBindTexture(GL_TEXTURE_2D, strip->atlas_tex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    u32 uploads = 0;
+    for (u32 i = 0; i < strip->count && uploads < THUMBNAIL_UPLOADS_PER_FRAME; ++i) {
+      Thumbnail *thumbnail = &strip->thumbnails[i];
+      if (thumbnail->is_uploaded || !thumbnail->is_ready) continue;
+
+      u32 x = (i % strip->columns) * strip->width;
+      u32 y = (i / strip->columns) * strip->height;
+      u8 *pixels = strip->pixels + (u64)i * strip->width * strip->height * 4;
+      glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, strip->width, strip->height,
+                      GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+      thumbnail->is_uploaded = true;
+      strip->num_uploaded++;
+      uploads++;
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+
+  ProfileEnd();
+}
+
+// Draws the thumbnails for source time [t0, t1] stretched over [p0, p1].
+// Only tiles inside the draw list's clip rect are emitted.
+static void draw_thumbnail_strip(ImDrawList *painter, Thumbnail_Strip *strip,
+                                 ImVec2 p0, ImVec2 p1, f64 t0, f64 t1) {
+  ProfileFuncBegin();
+
+  f32 tile_h = p1.y - p0.y;
+  f32 tile_w = tile_h * (f32)strip->width / (f32)strip->height;
+  f64 sec_per_px = (t1 - t0) / (p1.x - p0.x);
+
+  if (tile_w > 0.0f && sec_per_px > 0.0) {
+    ImVec2 clip_min = painter->GetClipRectMin();
+    ImVec2 clip_max = painter->GetClipRectMax();
+    f32 x_min = Max(p0.x, clip_min.x);
+    f32 x_max = Min(p1.x, clip_max.x);
+
+    u32 rows = (strip->count + strip->columns - 1) / strip->columns;
+    f32 atlas_w = (f32)(strip->columns * strip->width);
+    f32 atlas_h = (f32)(rows * strip->height);
+
+    s64 first_tile = (s64)floor((x_min - p0.x) / tile_w);
+    for (f32 x = p0.x + first_tile * tile_w; x < x_max; x += tile_w) {
+      f64 sec = t0 + (x - p0.x) * sec_per_px;
+      s64 index = (s64)(sec / strip->interval);
+      index = Clamp(0, index, (s64)strip->count - 1);
+
+      if (!strip->thumbnails[index].is_uploaded) continue;
+
+      f32 u = (f32)((index % strip->columns) * strip->width) / atlas_w;
+      f32 v = (f32)((index / strip->columns) * strip->height) / atlas_h;
+      ImVec2 uv0 = ImVec2(u, v);
+      ImVec2 uv1 = ImVec2(u + strip->width / atlas_w, v + strip->height / atlas_h);
+
+      // the last tile is cut off at the end of the clip
+      f32 w = Min(tile_w, p1.x - x);
+      uv1.x = uv0.x + (uv1.x - uv0.x) * (w / tile_w);
+
+      painter->AddImage(strip->atlas_tex,
+                        ImVec2(x, p0.y), ImVec2(x + w, p1.y), uv0, uv1);
+    }
+  }
+
+  ProfileEnd();
+}
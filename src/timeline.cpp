@@ -0,0 +1,264 @@
+static inline f64 timeline_clip_end(Timeline_Clip *clip) {
+  return clip->start + (clip->out_point - clip->in_point);
+}
+
+static Arena *timeline_array_arena(const char *name) {
+  // contiguous, so arrays can grow one element at a time
+  return arena_alloc((Arena_Params){
+    .name = name,
+    .flags = ARENA_FLAG__NO_CHAIN,
+    .reserve_size = GiB(1),
+    .commit_size = KiB(64),
+  });
+}
+
+static void timeline_init(Timeline *tl) {
+  ProfileFuncBegin();
+
+  *tl = {0};
+  tl->sources_arena = timeline_array_arena("timeline sources");
+  tl->clips_arena = timeline_array_arena("timeline clips");
+  tl->index_arena = timeline_array_arena("timeline index");
+  tl->sources = push_array_no_zero(tl->sources_arena, Timeline_Source, 0);
+  tl->clips = push_array_no_zero(tl->clips_arena, Timeline_Clip, 0);
+
+  ProfileEnd();
+}
+
+static void timeline_shutdown(Timeline *tl) {
+  ProfileFuncBegin();
+
+  arena_release(tl->sources_arena);
+  arena_release(tl->clips_arena);
+  arena_release(tl->index_arena);
+  *tl = {0};
+
+  ProfileEnd();
+}
+
+// Returns the index of the source, adds it if the timeline doesn't know it yet.
+static u32 timeline_add_source(Timeline *tl, const char *path, f64 duration) {
+  ProfileFuncBegin();
+
+  u64 id = hash_string(path);
+
+  u32 result = tl->num_sources;
+  for (u32 i = 0; i < tl->num_sources; ++i) {
+    if (tl->sources[i].id == id) {
+      result = i;
+      break;
+    }
+  }
+
+  if (result == tl->num_sources) {
+    Timeline_Source *source = push_array(tl->sources_arena, Timeline_Source, 1);
+    source->id = id;
+    snprintf(source->path, MAX_PATH_LENGTH, "%s", path);
+    source->duration = duration;
+    tl->num_sources++;
+  }
+
+  ProfileEnd();
+
+  return result;
+}
+
+static u32 timeline_add_track(Timeline *tl, const char *name) {
+  u32 result = tl->num_tracks;
+  if (tl->num_tracks < TIMELINE_MAX_TRACKS) {
+    Timeline_Track *track = &tl->tracks[tl->num_tracks++];
+    *track = {0};
+    snprintf(track->name, sizeof(track->name), "%s", name);
+  } else {
+    fprintf(stderr, "Timeline: no more than %d tracks\n", TIMELINE_MAX_TRACKS);
+    result = TIMELINE_MAX_TRACKS - 1;
+  }
+  return result;
+}
+
+static u32 timeline_add_clip(Timeline *tl, u32 source, u32 track, f64 start, f64 in_point, f64 out_point) {
+  ProfileFuncBegin();
+
+  Timeline_Clip *clip = push_array(tl->clips_arena, Timeline_Clip, 1);
+  clip->id = tl->next_clip_id++;
+  clip->source = source;
+  clip->track = track;
+  clip->start = start;
+  clip->in_point = in_point;
+  clip->out_point = Max(in_point, out_point);
+  clip->transform = layer_transform_identity;
+
+  u32 result = tl->num_clips++;
+  tl->is_index_dirty = true;
+
+  ProfileEnd();
+
+  return result;
+}
+
+// Moves the last clip into the hole, so clip indices are not stable across removals.
+static void timeline_remove_clip(Timeline *tl, u32 index) {
+  ProfileFuncBegin();
+
+  if (index < tl->num_clips) {
+    tl->clips[index] = tl->clips[tl->num_clips - 1];
+    tl->num_clips--;
+    arena_pop(tl->clips_arena, sizeof(Timeline_Clip));
+    tl->is_index_dirty = true;
+  }
+
+  ProfileEnd();
+}
+
+static Timeline_Clip *timeline_find_clip(Timeline *tl, u32 id) {
+  Timeline_Clip *result = NULL;
+  for (u32 i = 0; i < tl->num_clips && result == NULL; ++i) {
+    if (tl->clips[i].id == id) result = &tl->clips[i];
+  }
+  return result;
+}
+
+static void timeline_move_clip(Timeline *tl, u32 index, u32 track, f64 start) {
+  tl->clips[index].track = track;
+  tl->clips[index].start = start;
+  tl->is_index_dirty = true;
+}
+
+static int timeline_interval_compare(const void *a, const void *b) {
+  f64 sa = ((Timeline_Interval *)a)->start;
+  f64 sb = ((Timeline_Interval *)b)->start;
+  return (sa > sb) - (sa < sb);
+}
+
+// Implicit augmented interval tree over the sorted array (as in cgranges):
+// the node at index i sits at level k, the number of trailing one bits of i,
+// its children are i - 2^(k-1) and i + 2^(k-1). Returns the root's level.
+static s32 timeline_index_build(Timeline_Interval *a, s64 n) {
+  if (n <= 0) return -1;
+
+  s64 last_i = 0;
+  f64 last = 0.0;
+  for (s64 i = 0; i < n; i += 2) {
+    last_i = i;
+    last = a[i].max_end = a[i].end;
+  }
+
+  s32 k = 1;
+  for (; (1ll << k) <= n; ++k) {
+    s64 x = 1ll << (k - 1);
+    s64 i0 = (x << 1) - 1;
+    s64 step = x << 2;
+    for (s64 i = i0; i < n; i += step) {
+      // a missing right subtree is covered by the last node of the level below
+      f64 el = a[i - x].max_end;
+      f64 er = i + x < n ? a[i + x].max_end : last;
+      a[i].max_end = Max(a[i].end, Max(el, er));
+    }
+    last_i = (last_i >> k & 1) ? last_i - x : last_i + x;
+    if (last_i < n && a[last_i].max_end > last) {
+      last = a[last_i].max_end;
+    }
+  }
+
+  return k - 1;
+}
+
+static void timeline_rebuild_index(Timeline *tl) {
+  ProfileFuncBegin();
+
+  arena_clear(tl->index_arena);
+  tl->intervals = push_array_no_zero(tl->index_arena, Timeline_Interval, tl->num_clips);
+  tl->query_results = push_array_no_zero(tl->index_arena, u32, tl->num_clips);
+
+  for (u32 i = 0; i < tl->num_clips; ++i) {
+    Timeline_Clip *clip = &tl->clips[i];
+    tl->intervals[i] = (Timeline_Interval){
+      .start = clip->start,
+      .end = timeline_clip_end(clip),
+      .clip = i,
+    };
+  }
+
+  qsort(tl->intervals, tl->num_clips, sizeof(Timeline_Interval), timeline_interval_compare);
+  tl->index_levels = timeline_index_build(tl->intervals, tl->num_clips);
+  tl->is_index_dirty = false;
+
+  ProfileEnd();
+}
+
+// Finds the clips that overlap [t0, t1) in O(log n + k). Results are clip
+// indices sorted by clip start, valid until the next query or edit.
+static u32 timeline_query(Timeline *tl, f64 t0, f64 t1, u32 **out_clips) {
+  ProfileFuncBegin();
+
+  if (tl->is_index_dirty) {
+    timeline_rebuild_index(tl);
+  }
+
+  Timeline_Interval *a = tl->intervals;
+  s64 n = tl->num_clips;
+  u32 count = 0;
+
+  if (n > 0) {
+    struct { s64 x; s32 k, w; } stack[64];
+    s32 t = 0;
+    stack[t++] = { (1ll << tl->index_levels) - 1, tl->index_levels, 0 };
+
+    while (t > 0) {
+      auto z = stack[--t];
+      if (z.k <= 3) {
+        // small subtree, a linear scan is cheaper than descending
+        s64 i0 = z.x >> z.k << z.k;
+        s64 i1 = Min(i0 + (1ll << (z.k + 1)) - 1, n);
+        for (s64 i = i0; i < i1 && a[i].start < t1; ++i) {
+          if (t0 < a[i].end) tl->query_results[count++] = a[i].clip;
+        }
+      } else if (z.w == 0) {
+        // revisit this node after its left subtree
+        s64 y = z.x - (1ll << (z.k - 1));
+        stack[t++] = { z.x, z.k, 1 };
+        if (y >= n || a[y].max_end > t0) {
+          stack[t++] = { y, z.k - 1, 0 };
+        }
+      } else if (z.x < n && a[z.x].start < t1) {
+        if (t0 < a[z.x].end) tl->query_results[count++] = a[z.x].clip;
+        stack[t++] = { z.x + (1ll << (z.k - 1)), z.k - 1, 0 };
+      }
+    }
+  }
+
+  *out_clips = tl->query_results;
+
+  ProfileEnd();
+
+  return count;
+}
+
+// The clip that is visible at t: the one on the highest visible track.
+static Timeline_Clip *timeline_clip_at(Timeline *tl, f64 t) {
+  ProfileFuncBegin();
+
+  u32 *clips;
+  u32 count = timeline_query(tl, t, t + 1e-9, &clips);
+
+  Timeline_Clip *result = NULL;
+  for (u32 i = 0; i < count; ++i) {
+    Timeline_Clip *clip = &tl->clips[clips[i]];
+    if (tl->tracks[clip->track].is_hidden) continue;
+    if (result == NULL || clip->track > result->track) {
+      result = clip;
+    }
+  }
+
+  ProfileEnd();
+
+  return result;
+}
+
+static f64 timeline_duration(Timeline *tl) {
+  f64 result = 0.0;
+  for (u32 i = 0; i < tl->num_clips; ++i) {
+    result = Max(result, timeline_clip_end(&tl->clips[i]));
+  }
+  return result;
+}
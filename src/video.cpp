@@ -6,12 +6,79 @@ static void print_err(int code, const char *filename, int line) {
   fprintf(stderr, "ffmpeg error [%d] (%s:%d): %s \n", code, filename, line, desc);
 }
 
-static void video_open(Video *video, const char *path) {
+static u64 hash_string(const char *str) {
+  // FNV-1a
+  u64 hash = 14695981039346656037ull;
+  for (const char *c = str; *c; ++c) {
+    hash ^= (u8)*c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// Formats the renderer takes as they come out of the decoder, anything else
+// goes through sws_scale to YUV420P.
+static bool pixel_layout_from_format(AVPixelFormat format, Pixel_Layout *out_layout) {
+  bool result = true;
+  switch (format) {
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUVJ420P:   *out_layout = PIXEL_LAYOUT__YUV420P; break;
+    case AV_PIX_FMT_YUV420P10:  *out_layout = PIXEL_LAYOUT__YUV420P10; break;
+    case AV_PIX_FMT_NV12:       *out_layout = PIXEL_LAYOUT__NV12; break;
+    case AV_PIX_FMT_P010:       *out_layout = PIXEL_LAYOUT__P010; break;
+    default: result = false;
+  }
+  return result;
+}
+
+// Untagged streams are guessed like most players do: HD and up is BT.709.
+static Video_Color video_color_from_codec(AVCodecContext *codec_ctx) {
+  Video_Color result = {};
+
+  switch (codec_ctx->colorspace) {
+    case AVCOL_SPC_BT709:
+      result.matrix = COLOR_MATRIX__BT709;
+      break;
+    case AVCOL_SPC_BT2020_NCL:
+    case AVCOL_SPC_BT2020_CL:
+      result.matrix = COLOR_MATRIX__BT2020;
+      break;
+    case AVCOL_SPC_BT470BG:
+    case AVCOL_SPC_SMPTE170M:
+    case AVCOL_SPC_SMPTE240M:
+    case AVCOL_SPC_FCC:
+      result.matrix = COLOR_MATRIX__BT601;
+      break;
+    default:
+      result.matrix = codec_ctx->height >= 720 ? COLOR_MATRIX__BT709 : COLOR_MATRIX__BT601;
+  }
+
+  result.is_full_range = codec_ctx->color_range == AVCOL_RANGE_JPEG ||
+                         codec_ctx->pix_fmt == AV_PIX_FMT_YUVJ420P;
+
+  switch (codec_ctx->color_trc) {
+    case AVCOL_TRC_SMPTE2084:    result.transfer = COLOR_TRANSFER__PQ; break;
+    case AVCOL_TRC_ARIB_STD_B67: result.transfer = COLOR_TRANSFER__HLG; break;
+    case AVCOL_TRC_LINEAR:       result.transfer = COLOR_TRANSFER__LINEAR; break;
+    default:                     result.transfer = COLOR_TRANSFER__SDR;
+  }
+
+  return result;
+}
+
+// Returns false if the file can't be opened or has no video stream.
+static bool video_open(Video *video, const char *path, u32 flags) {
   ProfileFuncBegin();
 
+  video->source_id = hash_string(path);
+
   video->fmt_ctx = avformat_alloc_context();
 
-  chk_err(avformat_open_input(&video->fmt_ctx, path, NULL, NULL));
+  if (avformat_open_input(&video->fmt_ctx, path, NULL, NULL) < 0) {
+    fprintf(stderr, "Could not open '%s'\n", path);
+    ProfileEnd();
+    return false;
+  }
 
   chk_err(avformat_find_stream_info(video->fmt_ctx, NULL));
 
@@ -33,6 +100,13 @@ static void video_open(Video *video, const char *path) {
         codec = local_codec;
         codec_params = local_codec_params;
         video->time_base = video->fmt_ctx->streams[i]->time_base;
+        video->frame_rate = video->fmt_ctx->streams[i]->avg_frame_rate;
+        video->start_pts = video->fmt_ctx->streams[i]->start_time;
+        if (video->start_pts == AV_NOPTS_VALUE) video->start_pts = 0;
+        video->duration_pts = video->fmt_ctx->streams[i]->duration;
+        if (video->duration_pts == AV_NOPTS_VALUE) {
+          video->duration_pts = av_rescale_q(video->fmt_ctx->duration, AV_TIME_BASE_Q, video->time_base);
+        }
         printf("time base: %d/%d\n", video->time_base.num, video->time_base.den);
       }
       printf("video codec:\n  resolution: %d x %d\n", local_codec_params->width, local_codec_params->height);
@@ -46,37 +120,66 @@ static void video_open(Video *video, const char *path) {
 
   if (video->stream_index == -1) {
     fprintf(stderr, "No video stream found.\n");
-    // TODO: Error
+    avformat_close_input(&video->fmt_ctx);
+    ProfileEnd();
+    return false;
   }
 
   video->codec_ctx = avcodec_alloc_context3(codec);
   chk_err(avcodec_parameters_to_context(video->codec_ctx, codec_params));
 
   // configure codec for faster decoding
-  video->codec_ctx->skip_frame = AVDISCARD_NONREF;
-  video->codec_ctx->skip_loop_filter = AVDISCARD_NONKEY;
-  video->codec_ctx->skip_idct = AVDISCARD_NONKEY;
+  if (!(flags & VIDEO_OPEN_FLAG__FULL_QUALITY)) {
+    video->codec_ctx->skip_frame = AVDISCARD_NONREF;
+    video->codec_ctx->skip_loop_filter = AVDISCARD_NONKEY;
+    video->codec_ctx->skip_idct = AVDISCARD_NONKEY;
+  }
   video->codec_ctx->thread_count = 4;
   video->codec_ctx->thread_type = FF_THREAD_FRAME;
 
+  if (flags & VIDEO_OPEN_FLAG__KEYFRAMES_ONLY) {
+    video->codec_ctx->skip_frame = AVDISCARD_NONKEY;
+  }
+
   chk_err(avcodec_open2(video->codec_ctx, codec, NULL));
 
   video->width = video->codec_ctx->width;
   video->height = video->codec_ctx->height;
 
-  video->sws_ctx = sws_getContext(video->width, video->height, video->codec_ctx->pix_fmt,
-                                   video->width, video->height, AV_PIX_FMT_YUV420P,
-                                   SWS_BILINEAR, NULL, NULL, NULL);
+  video->color = video_color_from_codec(video->codec_ctx);
+
+  // the shader converts the supported layouts, only the rest is converted here
+  enum AVPixelFormat pix_fmt = video->codec_ctx->pix_fmt;
+  if (!pixel_layout_from_format(pix_fmt, &video->layout)) {
+    video->layout = PIXEL_LAYOUT__YUV420P;
+    video->sws_ctx = sws_getContext(video->width, video->height, pix_fmt,
+                                     video->width, video->height, AV_PIX_FMT_YUV420P,
+                                     SWS_BILINEAR, NULL, NULL, NULL);
+  }
+  printf("pixel format: %s, %s %s range, %s\n", av_get_pix_fmt_name(pix_fmt),
+         color_matrix_names[video->color.matrix], video->color.is_full_range ? "full" : "limited",
+         color_transfer_names[video->color.transfer]);
 
   video->packet = av_packet_alloc();
   video->frame = av_frame_alloc();
+  video->decoded_pts = AV_NOPTS_VALUE;
+
+  if (!(flags & (VIDEO_OPEN_FLAG__KEYFRAMES_ONLY | VIDEO_OPEN_FLAG__NO_KEYFRAME_INDEX))) {
+    keyframe_index_start(&video->keyframe_index, path, video->stream_index);
+  }
 
   ProfileEnd();
+
+  return true;
 }
 
 static void video_close(Video *video) {
   ProfileFuncBegin();
 
+  if (video->keyframe_index.arena) {
+    keyframe_index_shutdown(&video->keyframe_index);
+  }
+  sws_freeContext(video->sws_ctx);
   av_frame_free(&video->frame);
   av_packet_free(&video->packet);
   avcodec_free_context(&video->codec_ctx);
@@ -85,46 +188,147 @@ static void video_close(Video *video) {
   ProfileEnd();
 }
 
-static Video_Frame_YUV video_read_frame(Video *video, Arena *arena) {
+// Decodes the next frame of the video stream into video->frame.
+// Returns false at end of stream.
+static bool video_decode_next(Video *video) {
   ProfileFuncBegin();
 
   av_frame_unref(video->frame);
 
-  Video_Frame_YUV result = {0};
+  bool result = false;
+  for (;;) {
+    // the decoder may still hold frames from earlier packets
+    s32 response = avcodec_receive_frame(video->codec_ctx, video->frame);
+    if (response >= 0) {
+      video->decoded_pts = video->frame->best_effort_timestamp;
+      result = true;
+      break;
+    } else if (response == AVERROR_EOF) {
+      break;
+    } else if (response != AVERROR(EAGAIN)) {
+      chk_err(response);
+      break;
+    }
 
-  while (av_read_frame(video->fmt_ctx, video->packet) >= 0) {
-    // discard packets that are not from the video stream
-    if (video->packet->stream_index != video->stream_index) {
-      av_packet_unref(video->packet);
+    if (av_read_frame(video->fmt_ctx, video->packet) < 0) {
+      // end of file, drain the frames the decoder is still holding
+      avcodec_send_packet(video->codec_ctx, NULL);
       continue;
     }
 
-    // send the packet to the decoder
-    chk_err(avcodec_send_packet(video->codec_ctx, video->packet));
+    // discard packets that are not from the video stream
+    if (video->packet->stream_index == video->stream_index) {
+      chk_err(avcodec_send_packet(video->codec_ctx, video->packet));
+    }
+    av_packet_unref(video->packet);
+  }
 
-    // receive the decoded frame
-    s32 response = avcodec_receive_frame(video->codec_ctx, video->frame);
-    if (response == AVERROR(EAGAIN) || response == AVERROR(AVERROR_EOF)) {
-      av_packet_unref(video->packet);
-      continue;
-    } else {
-      chk_err(response);
+  ProfileEnd();
+
+  return result;
+}
+
+// Some containers don't store frame durations, fall back to the frame rate.
+static s64 video_frame_duration(Video *video, AVFrame *frame) {
+  s64 duration = frame->duration;
+  if (duration <= 0 && video->frame_rate.num > 0) {
+    duration = av_rescale_q(1, av_inv_q(video->frame_rate), video->time_base);
+  }
+  return Max(duration, 1);
+}
+
+// Copies the frame currently held in video->frame into a buffer from the frame
+// pool, with rows padded to FRAME_POOL_ALIGNMENT. If the pool is out of buffers
+// the planes go into the arena without padding instead. Layouts the renderer
+// can't take are converted to YUV420P.
+static Video_Frame_YUV video_convert_frame(Video *video, Arena *arena) {
+  ProfileFuncBegin();
+
+  const Pixel_Layout_Info *info = &pixel_layout_infos[video->layout];
+  u32 y_row_size = video->width * info->bytes_per_sample;
+  u32 uv_row_size = chroma_size(video->width) * info->bytes_per_sample * info->chroma_channels;
+
+  Video_Frame_YUV result = {0};
+  result.width = video->width;
+  result.height = video->height;
+  result.pts = video->frame->best_effort_timestamp;
+  result.duration = video_frame_duration(video, video->frame);
+  result.layout = video->layout;
+  result.color = video->color;
+
+  Frame_Pool *pool = frame_pool_get(video->width, video->height, video->layout);
+  Frame_Buffer *buffer = pool ? frame_pool_acquire(pool) : NULL;
+  if (buffer) {
+    result.buffer = buffer;
+    result.y_data = buffer->planes[0];
+    result.u_data = buffer->planes[1];
+    result.v_data = buffer->planes[2];
+    result.y_stride = pool->y_stride;
+    result.uv_stride = pool->uv_stride;
+  } else {
+    result.y_data = push_array_no_zero(arena, u8, y_row_size * video->height);
+    result.u_data = push_array_no_zero(arena, u8, uv_row_size * chroma_size(video->height));
+    if (info->num_planes == 3) {
+      result.v_data = push_array_no_zero(arena, u8, uv_row_size * chroma_size(video->height));
     }
+    result.y_stride = y_row_size;
+    result.uv_stride = uv_row_size;
+  }
 
-    result.width = video->width;
-    result.height = video->height;
-    result.y_data = push_array(arena, u8, video->width * video->height);
-    result.u_data = push_array(arena, u8, video->width * video->height / 4);
-    result.v_data = push_array(arena, u8, video->width * video->height / 4);
-    
-    u8 *dest[4] = { result.y_data, result.u_data, result.v_data, NULL };
-    s32 dest_linesize[4] = { video->width, video->width / 2, video->width / 2, 0 };
+  u8 *dest[4] = { result.y_data, result.u_data, result.v_data, NULL };
+  s32 dest_linesize[4] = { (s32)result.y_stride, (s32)result.uv_stride, (s32)result.uv_stride, 0 };
 
+  if (video->sws_ctx) {
     chk_err(sws_scale(video->sws_ctx, video->frame->data, video->frame->linesize,
         0, video->height, dest, dest_linesize));
+  } else {
+    for (u32 i = 0; i < info->num_planes; ++i) {
+      u32 rows = i == 0 ? video->height : chroma_size(video->height);
+      u32 row_size = i == 0 ? y_row_size : uv_row_size;
+      for (u32 y = 0; y < rows; ++y) {
+        memcpy(dest[i] + y * dest_linesize[i],
+               video->frame->data[i] + y * video->frame->linesize[i], row_size);
+      }
+    }
+  }
 
-    av_packet_unref(video->packet);
-    break;
+  ProfileEnd();
+
+  return result;
+}
+
+// Frames the renderer takes as is skip the copy and sws_scale, the planes point
+// into the decoded frame which is moved into ref and must outlive the upload.
+static Video_Frame_YUV video_ref_frame(Video *video, AVFrame *ref) {
+  ProfileFuncBegin();
+
+  av_frame_unref(ref);
+  av_frame_move_ref(ref, video->frame);
+
+  Video_Frame_YUV result = {0};
+  result.width = video->width;
+  result.height = video->height;
+  result.pts = ref->best_effort_timestamp;
+  result.duration = video_frame_duration(video, ref);
+  result.layout = video->layout;
+  result.color = video->color;
+  result.y_data = ref->data[0];
+  result.u_data = ref->data[1];
+  result.v_data = pixel_layout_infos[video->layout].num_planes == 3 ? ref->data[2] : NULL;
+  result.y_stride = ref->linesize[0];
+  result.uv_stride = ref->linesize[1];
+
+  ProfileEnd();
+
+  return result;
+}
+
+static Video_Frame_YUV video_read_frame(Video *video, Arena *arena) {
+  ProfileFuncBegin();
+
+  Video_Frame_YUV result = {0};
+  if (video_decode_next(video)) {
+    result = video_convert_frame(video, arena);
   }
 
   ProfileEnd();
@@ -142,40 +346,80 @@ static s64 sec_to_pts(AVRational time_base, f64 sec) {
   return pts;
 }
 
-static void video_seek(Video *video, f32 sec) {
+// Seeks so that video->frame holds the frame visible at sec.
+// Stream timestamps don't necessarily start at zero.
+static inline s64 video_sec_to_pts(Video *video, f64 sec) {
+  return video->start_pts + sec_to_pts(video->time_base, sec);
+}
+
+static inline f64 video_pts_to_sec(Video *video, s64 pts) {
+  return pts_to_sec(video->time_base, pts - video->start_pts);
+}
+
+static void video_seek(Video *video, f64 sec) {
   ProfileFuncBegin();
 
-  s64 pts = sec_to_pts(video->time_base, sec);
+  s64 pts = video_sec_to_pts(video, sec);
+
+  // when the decoder is already inside the target's GOP and behind the target,
+  // decoding forward is cheaper than seeking back to the same keyframe
+  Keyframe *keyframe = keyframe_index_find(&video->keyframe_index, pts);
+  bool decode_forward = keyframe != NULL &&
+                        video->decoded_pts != AV_NOPTS_VALUE &&
+                        video->decoded_pts >= keyframe->pts &&
+                        video->decoded_pts < pts;
+
+  if (!decode_forward) {
+    if (keyframe) {
+      // jump straight to the keyframe that starts the target's GOP
+      avformat_seek_file(video->fmt_ctx, video->stream_index,
+                         INT64_MIN, keyframe->pts, keyframe->pts, AVSEEK_FLAG_BACKWARD);
+    } else {
+      avformat_seek_file(video->fmt_ctx, video->stream_index,
+                         INT64_MIN, pts, INT64_MAX, AVSEEK_FLAG_BACKWARD);
+    }
+    avcodec_flush_buffers(video->codec_ctx);
+    video->decoded_pts = AV_NOPTS_VALUE;
+  }
 
+  // decode forward until we reach the frame that is visible at sec
+  while (video_decode_next(video)) {
+    AVFrame *frame = video->frame;
+    if (frame->best_effort_timestamp + video_frame_duration(video, frame) > pts) break;
+  }
+
+  ProfileEnd();
+}
+
+// Decodes only the keyframe at or before sec into video->frame.
+// Returns false if there is none.
+static bool video_seek_keyframe(Video *video, f64 sec) {
+  ProfileFuncBegin();
+
+  s64 pts = video_sec_to_pts(video, sec);
   avformat_seek_file(video->fmt_ctx, video->stream_index,
-                     INT64_MIN, pts, INT64_MAX, AVSEEK_FLAG_BACKWARD);
+                     INT64_MIN, pts, pts, AVSEEK_FLAG_BACKWARD);
   avcodec_flush_buffers(video->codec_ctx);
+  video->decoded_pts = AV_NOPTS_VALUE;
 
-  av_frame_unref(video->frame);
-  while (av_read_frame(video->fmt_ctx, video->packet) >= 0) {
-    if (video->packet->stream_index != video->stream_index) {
-      av_packet_unref(video->packet);
-      continue;
-    }
-
-    chk_err(avcodec_send_packet(video->codec_ctx, video->packet));
+  bool result = video_decode_next(video);
 
-    s32 response = avcodec_receive_frame(video->codec_ctx, video->frame);
-    if (response == AVERROR(EAGAIN) || response == AVERROR(AVERROR_EOF)) {
-      av_packet_unref(video->packet);
-      continue;
-    } else {
-      chk_err(response);
-    }
+  ProfileEnd();
 
-    s64 off = pts - video->frame->pts;
-    if (off > 0) continue;
+  return result;
+}
 
-    av_packet_unref(video->packet);
-    break;
+// Estimated number of frames that have to be decoded to seek to sec,
+// -1 if the keyframe index isn't ready yet.
+static s64 video_seek_cost(Video *video, f64 sec) {
+  s64 pts = video_sec_to_pts(video, sec);
+  Keyframe *keyframe = keyframe_index_find(&video->keyframe_index, pts);
+  if (keyframe == NULL) {
+    return -1;
   }
 
-  ProfileEnd();
+  f64 frames = (pts_to_sec(video->time_base, pts - keyframe->pts)) * av_q2d(video->frame_rate);
+  return (s64)frames + 1;
 }
 
 static inline u32 video_width(Video *video) {
@@ -187,5 +431,10 @@ static inline u32 video_height(Video *video) {
 }
 
 static inline f64 video_duration(Video *video) {
-  return pts_to_sec(video->time_base, video->fmt_ctx->duration);
+  return pts_to_sec(video->time_base, video->duration_pts);
+}
+
+static inline f64 video_fps(Video *video) {
+  if (video->frame_rate.den == 0) return 0.0;
+  return av_q2d(video->frame_rate);
 }
\ No newline at end of file
@@ -0,0 +1,266 @@
+static inline u32 video_decoder_count(Video_Decoder *dec) {
+  return dec->write_index - dec->read_index;
+}
+
+// name groups the slot's arena in the memory window.
+static void video_decoder_slot_init(Video_Decoder_Slot *slot, const char *name) {
+  slot->arena = arena_alloc((Arena_Params){
+    .name = name,
+    // decoded frames, large and written once
+    .flags = ARENA_FLAG__LARGE_PAGES,
+    .reserve_size = ARENA_DEFAULT_RESERVE_SIZE,
+    .commit_size = ARENA_DEFAULT_COMMIT_SIZE,
+  });
+  slot->av_frame = av_frame_alloc();
+}
+
+static void video_decoder_slot_shutdown(Video_Decoder_Slot *slot) {
+  video_frame_release(&slot->frame);
+  av_frame_free(&slot->av_frame);
+  arena_release(slot->arena);
+  slot->arena = NULL;
+}
+
+static void video_decoder_fill_slot(Video *video, Video_Decoder_Slot *slot) {
+  av_frame_unref(slot->av_frame);
+  video_frame_release(&slot->frame);
+  arena_pop_to(slot->arena, 0);
+
+  if (video->sws_ctx == NULL) {
+    slot->frame = video_ref_frame(video, slot->av_frame);
+  } else {
+    slot->frame = video_convert_frame(video, slot->arena);
+  }
+}
+
+static void *video_decoder_thread(void *ptr) {
+  Video_Decoder *dec = (Video_Decoder *)ptr;
+  Video *video = dec->video;
+
+  profile_thread_init();
+
+  pthread_mutex_lock(&dec->mutex);
+  while (dec->is_running) {
+    if (dec->seek_requested) {
+      f64 seek_time = dec->seek_time;
+      u32 generation = dec->generation;
+      dec->seek_requested = false;
+
+      // the ring was cleared when the seek was requested, so this slot is ours
+      Video_Decoder_Slot *slot = &dec->slots[dec->write_index % VIDEO_DECODER_RING_SIZE];
+      pthread_mutex_unlock(&dec->mutex);
+
+      video_seek(video, seek_time);
+      bool has_frame = video->frame->data[0] != NULL;
+      if (has_frame) {
+        video_decoder_fill_slot(video, slot);
+      }
+
+      pthread_mutex_lock(&dec->mutex);
+      if (generation == dec->generation) {
+        dec->end_of_stream = !has_frame;
+        if (has_frame) dec->write_index++;
+      }
+      continue;
+    }
+
+    if (dec->end_of_stream || video_decoder_count(dec) == VIDEO_DECODER_RING_SIZE) {
+      pthread_cond_wait(&dec->cond, &dec->mutex);
+      continue;
+    }
+
+    u32 generation = dec->generation;
+    Video_Decoder_Slot *slot = &dec->slots[dec->write_index % VIDEO_DECODER_RING_SIZE];
+    pthread_mutex_unlock(&dec->mutex);
+
+    bool has_frame = video_decode_next(video);
+    if (has_frame) {
+      video_decoder_fill_slot(video, slot);
+    }
+
+    pthread_mutex_lock(&dec->mutex);
+    if (generation != dec->generation) {
+      // a seek was requested while decoding, this frame is stale
+      continue;
+    }
+
+    if (has_frame) {
+      dec->write_index++;
+    } else {
+      dec->end_of_stream = true;
+    }
+  }
+  pthread_mutex_unlock(&dec->mutex);
+
+  profile_thread_shutdown();
+
+  scratch_release_thread();
+
+  return NULL;
+}
+
+static void video_decoder_init(Video_Decoder *dec, Video *video) {
+  ProfileFuncBegin();
+
+  dec->video = video;
+  dec->mutex = PTHREAD_MUTEX_INITIALIZER;
+  dec->cond = PTHREAD_COND_INITIALIZER;
+  dec->is_running = true;
+  dec->presented_pts = INT64_MIN;
+  dec->target_pts = INT64_MIN;
+
+  for (u32 i = 0; i < VIDEO_DECODER_RING_SIZE; ++i) {
+    video_decoder_slot_init(&dec->slots[i], "decoder frames");
+  }
+
+  pthread_create(&dec->thread, NULL, video_decoder_thread, (void *)dec);
+
+  ProfileEnd();
+}
+
+static void video_decoder_shutdown(Video_Decoder *dec) {
+  ProfileFuncBegin();
+
+  pthread_mutex_lock(&dec->mutex);
+  dec->is_running = false;
+  pthread_cond_signal(&dec->cond);
+  pthread_mutex_unlock(&dec->mutex);
+
+  pthread_join(dec->thread, NULL);
+
+  for (u32 i = 0; i < VIDEO_DECODER_RING_SIZE; ++i) {
+    video_decoder_slot_shutdown(&dec->slots[i]);
+  }
+
+  ProfileEnd();
+}
+
+// Drops all decoded frames and restarts decoding at sec.
+// Must not be called while a frame is acquired.
+static void video_decoder_seek(Video_Decoder *dec, f64 sec) {
+  ProfileFuncBegin();
+
+  pthread_mutex_lock(&dec->mutex);
+  dec->generation++;
+  dec->seek_requested = true;
+  dec->seek_time = sec;
+  dec->end_of_stream = false;
+  dec->read_index = dec->write_index;
+  pthread_cond_signal(&dec->cond);
+  pthread_mutex_unlock(&dec->mutex);
+
+  dec->presented_pts = INT64_MIN;
+
+  ProfileEnd();
+}
+
+// Presentation scheduler: maps sec to a target pts and looks for the frame that
+// should be on screen. Frames that are already behind the playhead are dropped,
+// if the next frame isn't due yet the current one stays up (repeated).
+// Returns true and fills out_frame if there is a new frame to show, the caller
+// has to video_decoder_release_frame once it has been uploaded. Pooled frames
+// can be kept longer with video_frame_retain.
+static bool video_decoder_acquire_frame(Video_Decoder *dec, f64 sec, Video_Frame_YUV *out_frame) {
+  ProfileFuncBegin();
+
+  Video *video = dec->video;
+  Video_Decoder_Stats *stats = &dec->stats;
+  s64 target_pts = video_sec_to_pts(video, sec);
+  s64 seek_threshold = sec_to_pts(video->time_base, VIDEO_DECODER_SEEK_THRESHOLD);
+
+  // only count repeats while the clock is moving, a paused frame isn't repeated
+  bool clock_moved = target_pts != dec->target_pts;
+  dec->target_pts = target_pts;
+
+  bool result = false;
+  bool needs_seek = false;
+
+  pthread_mutex_lock(&dec->mutex);
+  if (!dec->seek_requested) {
+    if (dec->presented_pts != INT64_MIN && target_pts < dec->presented_pts) {
+      // playback moved backwards
+      needs_seek = true;
+    } else if (video_decoder_count(dec) > 0) {
+      // drop frames that are already behind the playhead
+      while (video_decoder_count(dec) > 1) {
+        Video_Frame_YUV *next = &dec->slots[(dec->read_index + 1) % VIDEO_DECODER_RING_SIZE].frame;
+        if (next->pts > target_pts) break;
+        dec->read_index++;
+        stats->dropped++;
+      }
+
+      Video_Frame_YUV *front = &dec->slots[dec->read_index % VIDEO_DECODER_RING_SIZE].frame;
+      if (front->pts > target_pts) {
+        // early, keep showing the current frame
+        if (clock_moved) stats->repeated++;
+      } else if (front->pts + seek_threshold < target_pts && video_decoder_count(dec) == 1 && !dec->end_of_stream) {
+        // the decoder is too far behind, catch up by seeking
+        needs_seek = true;
+      } else {
+        *out_frame = *front;
+        result = true;
+        stats->presented++;
+      }
+      pthread_cond_signal(&dec->cond);
+    } else if (!dec->end_of_stream) {
+      if (dec->presented_pts != INT64_MIN && dec->presented_pts + seek_threshold < target_pts) {
+        needs_seek = true;
+      } else if (clock_moved) {
+        // the decoder hasn't caught up with the playhead
+        stats->starved++;
+      }
+    }
+  }
+  pthread_mutex_unlock(&dec->mutex);
+
+  if (needs_seek) {
+    video_decoder_seek(dec, sec);
+  }
+
+  if (result) {
+    dec->presented_pts = out_frame->pts;
+  }
+
+  ProfileEnd();
+
+  return result;
+}
+
+// Returns the next frame without consuming it or touching the scheduler, for
+// prerolling a decoder that isn't presenting yet. The frame stays valid until
+// the next seek, acquire or release on this decoder.
+static bool video_decoder_peek_frame(Video_Decoder *dec, Video_Frame_YUV *out_frame) {
+  ProfileFuncBegin();
+
+  pthread_mutex_lock(&dec->mutex);
+  bool result = !dec->seek_requested && video_decoder_count(dec) > 0;
+  if (result) {
+    *out_frame = dec->slots[dec->read_index % VIDEO_DECODER_RING_SIZE].frame;
+  }
+  pthread_mutex_unlock(&dec->mutex);
+
+  ProfileEnd();
+
+  return result;
+}
+
+static void video_decoder_release_frame(Video_Decoder *dec) {
+  ProfileFuncBegin();
+
+  pthread_mutex_lock(&dec->mutex);
+  dec->read_index++;
+  pthread_cond_signal(&dec->cond);
+  pthread_mutex_unlock(&dec->mutex);
+
+  ProfileEnd();
+}
+
+static void video_decoder_stats_ui(Video_Decoder *dec) {
+  Video_Decoder_Stats *stats = &dec->stats;
+
+  ImGui::Text("presented: %llu, dropped: %llu, repeated: %llu, starved: %llu",
+              stats->presented, stats->dropped, stats->repeated, stats->starved);
+  if (ImGui::Button("Reset stats")) {
+    *stats = {0};
+  }
+}
@@ -16,6 +16,8 @@ static const char *video_file_extensions[] = {
 };
 
 static void search_video_dirs(Video_Lister *lister) {
+  // subdirectories only live until the search is done
+  Temp scratch = scratch_begin(NULL, 0);
   Video_Source_Dir *current_dir = &lister->root_video_dir;
 
   while (current_dir != NULL) {
@@ -38,8 +40,7 @@ static void search_video_dirs(Video_Lister *lister) {
 
       if (entry->d_type == DT_DIR) {
         // Add directory to search list.
-        Video_Source_Dir *new_dir = (Video_Source_Dir *)malloc(sizeof(Video_Source_Dir));
-        memset(new_dir, 0, sizeof(Video_Source_Dir));
+        Video_Source_Dir *new_dir = push_array(scratch.arena, Video_Source_Dir, 1);
         memcpy(new_dir->path, fullpath, strlen(fullpath));
         new_dir->next = current_dir->next;
         current_dir->next = new_dir;
@@ -97,13 +98,8 @@ static void search_video_dirs(Video_Lister *lister) {
     current_dir = current_dir->next;
   }
 
-  // free all the additional dirs
-  for (Video_Source_Dir *it = lister->root_video_dir.next; it != NULL; ) {
-    Video_Source_Dir *next = it->next;
-    free(it);
-    it = next;
-  }
   lister->root_video_dir.next = NULL;
+  scratch_end(scratch);
 }
 
 static void video_lister_init(Video_Lister *lister) {